@@ -0,0 +1,147 @@
+// Abort Latency.cpp
+// Measures the time from an abort request (NanoScript_ABORT.h) to all outputs at zero,
+// for each kind of work a macro can be doing when the request comes in.
+// A second thread makes the requests at random times, the same way tools/AbortMacro.cpp does from outside.
+// Results go to "Abort Latency.txt"
+
+#include "NanoScript_GUI.h"
+#include "NanoScript_Litho.h"
+#include "NanoScript_TIMING.h"
+#include "NanoScript_SETTLE.h"
+#include "NanoScript_SWEEP.h"
+#include "NanoScript_ABORT.h"
+
+#include "windows.h" // for delay function
+#include "iostream" // for file manipulation
+#include "fstream"
+#include "math.h"
+#include "stdlib.h"
+using namespace std;
+
+#define WORKLOADS 4
+static const char* workloadName[WORKLOADS] = { "wait", "settle", "ramp", "pulse" };
+
+// Requests made by the second thread
+struct Requester
+{
+	int trials;
+	double minGap, maxGap;			// seconds between the answer to one request and the next request
+};
+
+static DWORD WINAPI RequestAborts(void* p)
+{
+	Requester* r = (Requester*)p;
+	srand(GetTickCount());
+	for (int i=0; i<r->trials; i++)
+	{
+		Sleep((DWORD)(1000 * (r->minGap + (r->maxGap - r->minGap) * rand() / RAND_MAX)));
+		double latency;
+		LithoRequestAbort(&latency, 5);
+	}
+	return 0;
+}
+
+// One round of the given work; the abort request ends it wherever it is
+static void RunWorkload(int kind, LithoAbortChannel& abortChannel, double Work_time, double Pulse_width,
+						double Ramp_volt, double* ramp_time, double* ramp_out, double* ramp_in, int capacity)
+{
+	LithoSignal in[1] = { lsNS5FPOutput2 };
+	switch (kind)
+	{
+	case 0:		// plain wait
+		LithoWaitUntil(LithoNow() + Work_time);
+		break;
+	case 1:		// settle wait that never settles (tolerance 0)
+		LithoWaitSettled(lsNS5FPOutput2, 0, Work_time);
+		break;
+	case 2:		// sweep of the tip bias with acquisition
+		LithoSweepAcquire(lsNS5FPOutput1, 0, Ramp_volt, Work_time, in, 1, 200, ramp_time, ramp_out, ramp_in, capacity);
+		break;
+	case 3:		// blocking pulses, checked in between
+		for (double t=0; t<Work_time; t+=Pulse_width)
+		{
+			LithoPulse(lsBias, 0, Pulse_width);
+			abortChannel.Check();
+		}
+		break;
+	}
+}
+
+extern "C" __declspec(dllexport) int macroMain()
+{
+
+	//===========================================================================================================================
+	//												Abort latency
+	//===========================================================================================================================
+	// Parameters with default values
+	int Trials = 100;							// abort requests
+	double Min_gap = 0.1;						// random time between requests (seconds)
+	double Max_gap = 0.7;
+	double Work_time = 0.25;					// length of one round of work (seconds)
+	double Pulse_width = 0.05;					// pulse width of the pulse workload (seconds)
+	double Ramp_volt = 0;						// end of the sweep of the ramp workload (Volts). 0 keeps the sample untouched
+
+	LITHO_BEGIN
+
+	LithoScan(false);							// turn off scanning
+
+	LithoAbortChannel abortChannel(false);		// throw LithoAbortRequest instead of ending the macro
+	LithoTimingStats stats[WORKLOADS];
+	LithoTimingStats all;
+	ofstream myfile1;
+	myfile1.open("Abort Latency.txt");
+	myfile1 << "trial\tworkload\tlatency (ms)\n";
+
+	int capacity = LithoSweepSamples(Work_time, 200);
+	double* ramp_time = new double[capacity];
+	double* ramp_out = new double[capacity];
+	double* ramp_in = new double[capacity];
+
+	Requester req = { Trials, Min_gap, Max_gap };
+	HANDLE thread = CreateThread(0, 0, RequestAborts, &req, 0, 0);
+
+	double end = LithoNow() + Trials * (Max_gap + Work_time) + 10;		// in case requests go missing
+	int kind = 0;
+	for (int t=0; t<Trials && LithoNow() < end; )
+	{
+		try
+		{
+			for (;;)
+			{
+				RunWorkload(kind, abortChannel, Work_time, Pulse_width, Ramp_volt, ramp_time, ramp_out, ramp_in, capacity);
+				kind = (kind + 1) % WORKLOADS;
+				if (LithoNow() > end)
+					break;
+			}
+		}
+		catch (LithoAbortRequest& r)
+		{
+			stats[kind].Add(r.latency);
+			all.Add(r.latency);
+			myfile1 << t << "\t" << workloadName[kind] << "\t" << 1000 * r.latency << "\n";
+			t++;
+			kind = (kind + 1) % WORKLOADS;
+		}
+	}
+	WaitForSingleObject(thread, 10000);
+	CloseHandle(thread);
+	delete[] ramp_time;
+	delete[] ramp_out;
+	delete[] ramp_in;
+
+	myfile1 << "\n# workload\tcount\tmean (ms)\tstddev\tmin\tmax\n";
+	for (int k=0; k<WORKLOADS; k++)
+		myfile1 << "# " << workloadName[k] << "\t" << stats[k].Count() << "\t" << 1000 * stats[k].Mean() << "\t"
+				<< 1000 * stats[k].StdDev() << "\t" << 1000 * stats[k].Min() << "\t" << 1000 * stats[k].Max() << "\n";
+	myfile1 << "# all\t" << all.Count() << "\t" << 1000 * all.Mean() << "\t"
+			<< 1000 * all.StdDev() << "\t" << 1000 * all.Min() << "\t" << 1000 * all.Max() << "\n";
+	myfile1 << "# worst case (ms)\t" << 1000 * all.Max() << "\n";
+	myfile1.close();
+
+	Beep(400,1000);
+	//======================================================================================================================================================
+
+	LITHO_END
+
+	return 0;	// 0 makes the macro unload. Return 1 to keep the macro loaded.
+}
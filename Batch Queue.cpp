@@ -0,0 +1,41 @@
+// Batch Queue.cpp
+// Runs the experiments listed in "Batch_queue.txt" back-to-back, without dialogs
+// Timing and outcome of every job go to "Batch_report.txt", see NanoScript_BATCH.h
+
+#include "NanoScript_GUI.h"
+#include "NanoScript_Litho.h"
+#include "NanoScript_BATCH.h"
+#include "NanoScript_EXPERIMENTS.h"
+
+#include "windows.h" // for delay function
+#include "iostream" // for file manipulation
+#include "fstream"
+#include "math.h"
+using namespace std;
+
+extern "C" __declspec(dllexport) int macroMain()
+{
+
+	//===========================================================================================================================
+	//												Batch experiment queue
+	//===========================================================================================================================
+	// Parameters with default values
+	double Move_rate = 5;						// tip speed between job positions (um/s)
+
+	LITHO_BEGIN
+
+	LithoScan(false);							// turn off scanning
+
+	int count;
+	const BatchExperimentEntry* experiments = LithoExperiments(count);
+	int ok = LithoRunBatch("Batch_queue.txt", "Batch_report.txt", experiments, count, Move_rate);
+
+	LithoSetZero(lsNS5FPOutput1);
+	LithoSetZero(lsBias,false);
+	Beep(ok >= 0 ? 400 : 200,1000);
+	//======================================================================================================================================================
+
+	LITHO_END
+
+	return 0;	// 0 makes the macro unload. Return 1 to keep the macro loaded.
+}
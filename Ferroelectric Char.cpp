@@ -4,12 +4,19 @@
 
 #include "NanoScript_GUI.h"
 #include "NanoScript_Litho.h"
+#include "NanoScript_CALIB.h"
+#include "NanoScript_SWEEP.h"
+#include "NanoScript_INSTRUMENT.h"
+#include "NanoScript_KPFM.h"
+#include "NanoScript_DATASET.h"
+#include "NanoScript_ARENA.h"
 
 //by Zhiyong
 #include "windows.h" // for delay function
 #include "iostream" // for file manipulation
 #include "fstream"
 #include "math.h"
+#include <vector>
 using namespace std;
 
 extern "C" __declspec(dllexport) int macroMain()
@@ -26,7 +33,10 @@ extern "C" __declspec(dllexport) int macroMain()
 	double V_start = 8;							 // Start of the Voltage of the pulse (Volts)
 	double Pulse_time=1;						// The time that the pulse will run (seconds)	
 	double Wait_time = 0;						// The time delay until the voltage sweep runs (seconds)
-	double Amp = 0;
+	double Read_rate = 200;						// Points per second of the read sweep, once calibrated (Hz)
+	bool Search_mode = false;					// Only find where the read sweep crosses zero, with a root search (~12 points instead of 401)
+	bool Calibrate_output = false;				// Step lsNS5FPOutput1 through the read range (9 points, +-2 V) and save the calibration. Lift the tip first!
+	const char* Calib_file = "Ferroelectric Char.cal";	// Calibration of lsNS5FPOutput1, loaded when Calibrate_output is false
 	double Phase =0;
 	double Amplitude= 0;
 
@@ -49,6 +59,41 @@ extern "C" __declspec(dllexport) int macroMain()
 	ofstream myfile1;
 	myfile1.open("Ferroelectric Char.txt");
 
+	// The read sweep runs in hard units; soft<->hard conversion is measured once instead of on every call
+	int N_read=int(4*V_step)+1;							// points per read sweep
+	vector<double> set_hard(N_read), read_hard(N_read), read_soft(N_read);
+	// The output calibration sets the tip bias, so it is only measured on request; otherwise the saved one is used
+	LithoCalibration cal;
+	bool set_fast=false;
+	if (Calibrate_output)
+	{
+		set_fast=cal.CalibrateOutput(lsNS5FPOutput1,-2,2);	// same range as the read sweep
+		if (set_fast)
+			cal.Save(Calib_file);
+	}
+	else
+		set_fast=cal.Load(Calib_file) && cal.IsCalibrated(lsNS5FPOutput1);
+	if (!set_fast)
+		WriteMsg2Log(1, "Ferroelectric Char: lsNS5FPOutput1 not calibrated, the read sweep is set in soft units");
+	bool read_fast=false;								// lsNS5FPOutput2 is calibrated from the first sweep
+	for (int n=0; n<N_read; n++)
+		set_hard[n]=cal.ToHard(lsNS5FPOutput1,(2*V_step-n)/V_step);
+	if (set_fast && cal.Transfer(lsNS5FPOutput1).linear)	// the limits check the hard unit ramp in volts too
+		LithoLimits().HardUnits(lsNS5FPOutput1,cal.Transfer(lsNS5FPOutput1).gain,cal.Transfer(lsNS5FPOutput1).offset);
+
+	// Same data as an indexed file: one chunk per write voltage, see NanoScript_DATASET.h
+	// Search_mode: the zero crossing (mV) for every write voltage
+	LithoDatasetAxis axes[2]={LithoAxis("write_V",int(2*V_start)+1,1,V_start,-1),LithoAxis("read_V",N_read,N_read,2,-1/V_step)};
+	LithoDataset data;
+	if (Search_mode)
+		axes[0]=LithoAxis("write_V",int(2*V_start)+1,int(2*V_start)+1,V_start,-1);
+	if (!data.Create("Ferroelectric Char.lds",Search_mode ? 1 : 2,axes))
+		WriteMsg2Log(1, "Ferroelectric Char: cannot create Ferroelectric Char.lds, only the text file is written");
+	data.Reserve(1);									// one chunk in memory, reused for every write voltage
+	LithoArena arena(64*1024);							// per-sweep buffers
+	arena.Reserve(2*N_read*sizeof(double)+16);			// taken now: the first calibrated sweep may be any sweep
+	int allocating_sweeps=0;
+
 	//for (int j=0; j<=4*V_step;j++)							// Top row of data output
 	//{
 	//	myfile1 << "\t" << 2-(j/V_step) ;
@@ -59,9 +104,9 @@ extern "C" __declspec(dllexport) int macroMain()
 		//myfile1 << k << "\t" ;
 		
 		LithoScan(false);
-		LithoSetSoft(lsNS5FPOutput1,k);						//Units are in Volts
+		LithoSetSoftLimited(lsNS5FPOutput1,k);				//Units are in Volts, refused outside the session limits
 		Sleep(1000*Pulse_time);								//Time that the pulse is being given
-		LithoSetSoft(lsNS5FPOutput1,0);
+		LithoSetZero(lsNS5FPOutput1);
 		Sleep(1000*Wait_time);
 		
 
@@ -79,20 +124,75 @@ extern "C" __declspec(dllexport) int macroMain()
 		}
 	*/											// This code is for taking a single measurement, not a sweep.										// This code is for taking a single measurement, not a sweep.
 
+	if (Search_mode)
+	{
+		// same range as the read sweep, output: k, zero crossing (mV), points read
+		LithoHardware afm;
+		KpfmSearchParams search;
+		search.lo=-2;
+		search.hi=2;
+		KpfmSearchResult sr=KpfmFindZero(afm,search);
+		if (sr.found)
+		{
+			long long at[1]={(long long)(V_start-k)};
+			data.Set(at,1000*sr.potential);
+			data.Flush();
+		}
+		else
+			WriteMsg2Log(1, "Ferroelectric Char: no zero crossing of the read sweep found");
+		myfile1 << k << "\t" << (sr.found ? 1000*sr.potential : NAN) << "\t" << sr.points << "\n";	// nan if not found
+		continue;
+	}
 	
-	
-	for (int ii=2*V_step;ii>=-2*V_step;ii--)		//Contorls the number steps
+	LithoHeapCheck sweep_heap;							// arena blocks and dataset chunks taken from the read sweep to the stored values
+	if (read_fast && set_fast && cal.Transfer(lsNS5FPOutput1).linear)
 	{
-checkzero:
-		//LithoPulse(lsBias,1000*Pulse_voltage,Pulse_time);
-		LithoSetSoft(lsNS5FPOutput1,(ii / V_step)); //Units are in Volts
-										
-		Amp=LithoGetSoft(lsNS5FPOutput2);
-		Amplitude=1000*Amp;
-		//Phase=LithoGetSoft(lsNS5FPOutput1);
-		
+		// calibrated: the same set/get steps as the loop below, on a fixed clock and in hard units
+		// time stamps and output values only live for this sweep: taken from the arena, no heap allocation
+		LithoArenaScope sweep(arena);
+		LithoSignal in[1]={lsNS5FPOutput2};
+		double* ramp_time=arena.Alloc<double>(N_read);
+		double* ramp_out=arena.Alloc<double>(N_read);
+		int got=LithoSweepAcquire(lsNS5FPOutput1,set_hard[0],set_hard[N_read-1],(N_read-1)/Read_rate,in,1,Read_rate,
+								 ramp_time,ramp_out,&read_hard[0],N_read,0,false);
+		if (got!=N_read)								// buffers too small (-1), refused by the limits (0) or a set failed
+		{
+			WriteMsg2Log(1, "Ferroelectric Char: read sweep incomplete, missing points are not written");
+			for (int n=got>0 ? got : 0; n<N_read; n++)
+				read_hard[n]=NAN;						// not the previous sweep
+		}
+	}
+	else
+		for (int ii=2*V_step;ii>=-2*V_step;ii--)		//Contorls the number steps
+		{
+			int n=int(2*V_step)-ii;
+			//LithoPulse(lsBias,1000*Pulse_voltage,Pulse_time);
+			if (set_fast)
+				LithoSetLimited(lsNS5FPOutput1,set_hard[n]);	//Hard units, precomputed from ii / V_step Volts
+			else
+				LithoSetSoftLimited(lsNS5FPOutput1,(ii / V_step)); //Units are in Volts
+
+			read_hard[n]=LithoGet(lsNS5FPOutput2);
+			if (!read_fast)
+				read_soft[n]=LithoGetSoft(lsNS5FPOutput2);	//Until calibrated, also read in soft units
+			//Phase=LithoGetSoft(lsNS5FPOutput1);
+		}
+	if (read_fast)
+		cal.ToSoft(lsNS5FPOutput2,&read_hard[0],&read_soft[0],N_read);	//Whole sweep converted at once
+	else
+		read_fast=cal.CalibratePairs(lsNS5FPOutput2,&read_hard[0],&read_soft[0],N_read);
+	for (int ii=2*V_step;ii>=-2*V_step;ii--)
+	{
+		Amplitude=1000*read_soft[int(2*V_step)-ii];
+		if (Amplitude!=Amplitude)
+			continue;									// not read in this sweep
 		myfile1 << k << "\t" << ii << "\t" << Amplitude << "\n";
+		long long at[2]={(long long)(V_start-k),(long long)(int(2*V_step)-ii)};
+		data.Set(at,Amplitude);
 	}
+	if (k<V_start && sweep_heap.Allocations()>0)		// the first sweep calibrates and sizes the buffers
+		allocating_sweeps++;
+	data.Flush();									// file complete up to this write voltage
 	                                                   
 	
 	/*if (LithoGetSoft(lsNS5FPOutput2)==0) {
@@ -137,11 +237,16 @@ checkzero:
 
 	}
 	myfile1.close();
+	data.Close();
+	if (arena.HeapAllocations() > 1)					// the first sweep sizes the arena, later ones must not allocate
+		WriteMsg2Log(1, "Ferroelectric Char: sweep buffers outgrew the arena block");
+	if (allocating_sweeps>0)
+		WriteMsg2Log(1, "Ferroelectric Char: read sweeps grew the arena or the dataset cache");
 	
 	
 
 
-	LithoSetSoft(lsNS5FPOutput1,0);
+	LithoSetZero(lsNS5FPOutput1);
 	Beep(400,1000);
 	//======================================================================================================================================================
 	
@@ -4,6 +4,10 @@
 
 #include "NanoScript_GUI.h"
 #include "NanoScript_Litho.h"
+#include "NanoScript_LIMITS.h"
+#include "NanoScript_TIMING.h"
+#include "NanoScript_INSTRUMENT.h"
+#include "NanoScript_KPFM.h"
 
 //by Zhiyong
 #include "windows.h" // for delay function
@@ -27,6 +31,8 @@ extern "C" __declspec(dllexport) int macroMain()
 	double V_start = 7;							 // Voltage to sweep
 	double potential_1=0;
 	float z=0;
+	int N_null = 10;							// potential readings after the write pulse, by nulling instead of a sweep
+	double Null_wait = 0.5;						// time between readings, on top of the nulling itself (seconds)
 	/*ifstream myfile;		   					// Start reading settings from text file
     myfile.open("KPFM_settings.txt");
 	myfile >> z;
@@ -122,9 +128,26 @@ extern "C" __declspec(dllexport) int macroMain()
 	myfile1.close();
 	*/
 	LithoScan(false);
-	LithoSetSoft(lsNS5FPOutput1,10);//Units are in Volts
+	LithoSetSoftLimited(lsNS5FPOutput1,10);//Units are in Volts
 		Sleep(5000);				//Time that the pulse is being given
-	LithoSetSoft(lsNS5FPOutput1,0);
+	LithoSetZero(lsNS5FPOutput1);
+	LithoStopwatch since_pulse;					// time column of KPFM.txt
+
+	// surface potential after the pulse: the nulling bias, one value in milliseconds
+	LithoHardware afm;
+	KpfmNullParams null_params;
+	ofstream potfile;
+	potfile.open("KPFM.txt");
+	for (int n=0;n<N_null;n++)
+	{
+		KpfmNullResult r=KpfmNull(afm,null_params);
+		null_params.start=r.potential;			// next reading starts from this one
+		Potential=1000*r.potential;				// Units are in Millivolts
+		potfile << since_pulse.Elapsed() << "\t" << Potential << "\t" << r.nulled << "\t" << r.secs << "\n";
+		Sleep(1000*Null_wait);
+	}
+	potfile.close();
+	LithoSetZero(lsNS5FPOutput1);
 
 	Beep(400,1000);
 	//======================================================================================================================================================
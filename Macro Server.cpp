@@ -0,0 +1,147 @@
+// Macro Server.cpp
+// Resident macro: stays loaded and serves experiment requests from other programs
+// over the pipe of NanoScript_SERVER.h, in one Litho session per run (see tools/MacroClient.cpp)
+// Startup cost and per-request latency go to "Macro_server_latency.txt"
+
+#include "NanoScript_GUI.h"
+#include "NanoScript_Litho.h"
+#include "NanoScript_BATCH.h"
+#include "NanoScript_EXPERIMENTS.h"
+#include "NanoScript_SERVER.h"
+#include "NanoScript_TIMING.h"
+
+#include "windows.h" // for delay function
+#include "iostream" // for file manipulation
+#include "fstream"
+#include "math.h"
+using namespace std;
+
+// kept between runs while the DLL stays loaded; the pipe is only open during a run
+static LithoRequestPipe requests;
+static int invocations = 0;
+static int served = 0;
+
+extern "C" __declspec(dllexport) int macroMain()
+{
+
+	//===========================================================================================================================
+	//												Resident macro server
+	//===========================================================================================================================
+	// Parameters with default values
+	double Move_rate = 5;						// tip speed between job positions (um/s)
+	double Idle_timeout = 600;					// give control back to Nanoscope after this long without requests (s)
+	double Poll_interval = 0.02;				// pipe polling period while idle (s)
+
+	invocations++;
+	bool quit = false;
+	ofstream timing("Macro_server_latency.txt", ios::app);
+	timing << "# run " << invocations << (invocations > 1 ? ", DLL already loaded" : ", DLL loaded") << "\n";
+
+	if (!requests.Open())
+	{
+		WriteMsg2Log(2, "Macro server: cannot create the request pipe, is another server running?");
+		return 0;
+	}
+
+	// LITHO_BEGIN written out, to time LithoBegin
+	try
+	{
+		LithoStopwatch begin;
+		if (LithoBegin())
+		{
+			timing << "# LithoBegin " << begin.Elapsed() << " s, paid once for all requests of this run\n";
+			timing << "#request\texperiment\tok\tdispatch_s\trun_s\n";
+
+			LithoScan(false);						// turn off scanning
+
+			WriteMsg2Log(0, "Macro server: waiting for requests");
+			LithoStopwatch idle;
+			while (!quit && idle.Elapsed() < Idle_timeout)
+			{
+				if (!requests.Poll())
+				{
+					LithoPause(Poll_interval);		// lets Nanoscope abort the server
+					continue;
+				}
+
+				string line, reply;
+				if (!requests.ReadLine(line))
+				{
+					requests.Disconnect();
+					continue;
+				}
+				LithoStopwatch dispatch;
+				BatchJob job;
+				string error;
+				if (line == "quit")
+				{
+					quit = true;
+					reply = "ok 0 0 quitting";
+				}
+				else if (line == "ping")
+				{
+					char buf[64];
+					_snprintf(buf, sizeof(buf), "ok 0 %g pong", dispatch.Elapsed());
+					buf[sizeof(buf) - 1] = 0;
+					reply = buf;
+				}
+				else if (line == "stats")
+				{
+					char buf[128];
+					_snprintf(buf, sizeof(buf), "ok 0 0 run %d, served %d", invocations, served);
+					buf[sizeof(buf) - 1] = 0;
+					reply = buf;
+				}
+				else if (!LithoParseBatchLine(line, job, error))
+					reply = "fail 0 0 cannot read '" + (error.empty() ? line : error) + "'";
+				else
+				{
+					job.index = served++;
+					job.line = 0;
+					double latency = dispatch.Elapsed();
+					BatchResult r;
+					try
+					{
+						int count;
+						const BatchExperimentEntry* experiments = LithoExperiments(count);
+						r = LithoRunJob(job, experiments, count, Move_rate);
+					}
+					catch (LithoException&)
+					{
+						requests.WriteLine("fail 0 0 aborted");
+						requests.Disconnect();
+						throw;
+					}
+					char buf[64];
+					_snprintf(buf, sizeof(buf), "%s %g %g ", r.ok ? "ok" : "fail", r.runSecs, latency);
+					buf[sizeof(buf) - 1] = 0;
+					reply = buf + r.message;
+					timing << job.index << "\t" << job.experiment << "\t" << r.ok << "\t" << latency << "\t" << r.runSecs << endl;
+
+					LithoSetZero(lsNS5FPOutput1);
+					LithoSetZero(lsBias,false);
+				}
+				requests.WriteLine(reply);
+				requests.Disconnect();
+				idle.Restart();
+			}
+		}
+		LithoEnd();
+	}
+	catch (LithoException& le)
+	{
+		cout << "Caught LithoException: " << le.what() << "\n";
+		LithoEnd();
+		quit = true;
+	}
+
+	requests.Close();						// nobody serves it until the next run
+	if (quit)
+	{
+		Beep(200,1000);
+		return 0;	// unload on quit or abort
+	}
+	Beep(400,1000);
+	return 1;	// stay loaded: the next run skips loading the DLL
+	//======================================================================================================================================================
+}
@@ -0,0 +1,102 @@
+// Motion Plan.cpp
+// Runs a lithography path and a grid of measurement points with the motion planner (NanoScript_MOTION.h)
+// and compares the planned with the executed time, and with one LithoTranslate per segment at a constant rate.
+// Feedback stays as it is and the bias is not touched, so the lithography path only moves the tip.
+// Results go to "Motion Plan.txt"
+
+#include "NanoScript_GUI.h"
+#include "NanoScript_Litho.h"
+#include "NanoScript_INSTRUMENT.h"
+#include "NanoScript_MOTION.h"
+
+#include "windows.h" // for delay function
+#include "iostream" // for file manipulation
+#include "fstream"
+#include "math.h"
+using namespace std;
+
+static void Report(ofstream& out, const char* workload, const LithoMotionReport& r)
+{
+	out << workload << "\t" << r.segments << "\t" << r.calls << "\t" << (r.segments ? double(r.calls) / r.segments : 0)
+		<< "\t" << r.plannedSecs << "\t" << r.executedSecs
+		<< "\t" << r.executedSecs - r.plannedSecs << "\t" << r.constantSecs << "\n";
+}
+
+extern "C" __declspec(dllexport) int macroMain()
+{
+
+	//===========================================================================================================================
+	//												Motion planning
+	//===========================================================================================================================
+	// Parameters with default values
+	double Accel = 50;							// maximum acceleration (um/s^2)
+	double Corner = 0.05;						// allowed deviation from the path at corners (um)
+	double Ramp_lag = 0.2;						// how far the tip may run ahead of or behind a speed ramp (um)
+	double Litho_size = 5;						// side of the outer turn of the square spiral (um)
+	int Litho_turns = 12;						// sides of the spiral
+	int Litho_points = 5;						// segments per side, as a pattern from a point list has them
+	double Litho_rate = 10;						// writing speed (um/s)
+	int Grid_n = 8;								// grid of Grid_n x Grid_n measurement points
+	double Grid_pitch = 1;						// distance between the points (um)
+	double Grid_rate = 20;						// moving speed between the points (um/s)
+	double Grid_dwell = 0.05;					// time at each point (seconds)
+
+	LITHO_BEGIN
+
+	LithoScan(false);							// turn off scanning
+	LithoCenterXY();
+
+	ofstream myfile1("Motion Plan.txt");
+	myfile1 << "#workload\tsegments\tcalls\tcalls per segment\tplanned (s)\texecuted (s)\tlate (s)\tconstant rate (s)\n";
+
+	LithoHardware afm;
+	LithoMotionPlanner plan(Accel, Corner, Ramp_lag);
+	LithoMotionReport r;
+
+	// lithography: square spiral with its outer corner at the center of the field, each side in Litho_points segments
+	plan.Start(0,0);
+	double x=0, y=0;
+	for (int t=0; t<Litho_turns; t++)
+	{
+		double side = Litho_size * (Litho_turns - t) / Litho_turns;
+		double dx = t%4==0 ? 1 : t%4==2 ? -1 : 0;
+		double dy = t%4==1 ? 1 : t%4==3 ? -1 : 0;
+		for (int k=1; k<=Litho_points; k++)
+			plan.LineTo(x + dx*side*k/Litho_points, y + dy*side*k/Litho_points, Litho_rate);
+		x += dx*side;
+		y += dy*side;
+	}
+	plan.Execute(afm, r);
+	Report(myfile1, "litho", r);
+
+	// back to the center of the field
+	plan.LineTo(0, 0, Grid_rate);
+	plan.Execute(afm, r);
+
+	// grid: stop at every point, serpentine rows
+	LithoMotionReport grid = { 0, 0, 0, 0, 0, 0 };
+	for (int i=0; i<Grid_n; i++)
+		for (int j=0; j<Grid_n; j++)
+		{
+			int col = i%2==0 ? j : Grid_n - 1 - j;
+			plan.LineTo(col*Grid_pitch, i*Grid_pitch, Grid_rate);
+			plan.Execute(afm, r);
+			grid.segments += r.segments;
+			grid.calls += r.calls;
+			grid.done += r.done;
+			grid.plannedSecs += r.plannedSecs;
+			grid.executedSecs += r.executedSecs;
+			grid.constantSecs += r.constantSecs;
+			LithoPause(Grid_dwell);				// the measurement at the point goes here
+		}
+	Report(myfile1, "grid", grid);
+	myfile1.close();
+
+	LithoCenterXY();
+	Beep(400,1000);
+	//======================================================================================================================================================
+
+	LITHO_END
+
+	return 0;	// 0 makes the macro unload. Return 1 to keep the macro loaded.
+}
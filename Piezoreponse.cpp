@@ -4,6 +4,11 @@
 
 #include "NanoScript_GUI.h"
 #include "NanoScript_Litho.h"
+#include "NanoScript_SETTLE.h"
+#include "NanoScript_SIGNALS.h"
+#include "NanoScript_FEED.h"
+#include "NanoScript_PHASE.h"
+#include "NanoScript_ABORT.h"
 
 //by Zhiyong
 #include "windows.h" // for delay function
@@ -23,7 +28,12 @@ extern "C" __declspec(dllexport) int macroMain()
 	float V_max = 8.0f; 		// the maximum voltage
 	float V_step = 0.05f;	    // the voltage step
 	float pulse_dura=0.1f;          //the time of the pulse
-	float post_pulse_time=0.3f;    //the time wait until capture
+	float post_pulse_time=0.3f;    //the longest time to wait until capture
+	double settle_tol=0.0005;      //the amplitude is captured once it is stable to within this (Volts); the phase is not checked
+	double amp_sem=0.2;            //amplitude and phase are averaged as a vector until its standard error is below this (mV)
+	double pha_sem=0.5;            //and that of its angle below this (degrees)
+	int min_reads=3;               //read pairs at least, also the block size after the first block
+	int max_reads=30;              //read pairs at most
 
 	LITHO_BEGIN	
 
@@ -35,11 +45,15 @@ extern "C" __declspec(dllexport) int macroMain()
 	int ii;
 	int Trig;
 	ofstream myfile;
+	myfile.open("A_zhiyong.txt");	//opened once, every point is appended
 	double flag=1;
 	double Volt_now=0;
+	LithoFeedWriter feed("Piezoresponse","volt\tphase\tamp\tsettle\tpha_sem\tamp_sem\treads");	//live view: tools/FeedTail
+	LithoAbortChannel abortChannel;	//tools/AbortMacro stops the loop at once, also during the settle wait
 	//read
 while(1)
 {
+	abortChannel.Check();
 	ifstream myfile1;
     myfile1.open("Trig.txt");
 	myfile1 >> Trig;
@@ -59,19 +73,15 @@ while(1)
 		else
 		{	
 			Volt_now+=(V_step*flag);
-			LithoPulse(lsBias,1000*Volt_now,pulse_dura);
-			Sleep(post_pulse_time*1000);
-			double amp=1000*LithoGetSoft(lsNS5FPOutput1);
-			amp=amp+1000*LithoGetSoft(lsNS5FPOutput1);
-			amp=amp+1000*LithoGetSoft(lsNS5FPOutput1);
-			amp=amp/3;
-			double pha=180/10*LithoGetSoft(lsNS5FPOutput2);
-			pha=pha+180/10*LithoGetSoft(lsNS5FPOutput2);
-			pha=pha+180/10*LithoGetSoft(lsNS5FPOutput2);
-			pha=pha/3;
-			myfile.open("A_zhiyong.txt");
-			myfile << Volt_now << "\t" << pha<<"\t"<<amp<< "\n";
-			myfile.close();
+			LithoPulseAs<lsBias>(Volts(Volt_now),pulse_dura);
+			LithoSettleResult settle=LithoWaitSettled(PfmAmplitude::signal,settle_tol,post_pulse_time);
+			LithoVectorAverage v=LithoVectorAverageUntil([]{ return LithoReadChannel<PfmAmplitude>().value; },		//mV
+														 []{ return LithoReadChannel<PfmPhase>().value; },			//degrees
+														 amp_sem,pha_sem,min_reads,max_reads,min_reads);
+			double pha=v.phase;		//wrapped, -180 .. 180: switching jumps by 180 degrees, which unwrapping would turn into drift
+			double point[7]={Volt_now,pha,v.amplitude,settle.secs,v.phaseSem,v.sem,double(2*v.count)};
+			feed.Publish(point,7);
+			myfile << Volt_now << "\t" << pha<<"\t"<<v.amplitude<<"\t"<<settle.secs<<"\t"<<v.phaseSem<<"\t"<<v.sem<<"\t"<<2*v.count<<"\t"<<v.x<<"\t"<<v.y<< "\n";
 		}
 	}
 }
@@ -0,0 +1,170 @@
+// Relaxor Async.cpp
+// Relaxor Char.cpp as a coroutine script (NanoScript_TASK.h): pulse, then record lsNS5FPOutput2 on a fixed clock.
+// Writing the file, the logarithmic relaxation fit and reading the stop flag from Relaxor_settings.txt
+// run in the waits between samples instead of in the record loop.
+// Results go to "Relaxor Async.txt", with the fit and the timing of the samples at the end
+
+#include "NanoScript_GUI.h"
+#include "NanoScript_Litho.h"
+#include "NanoScript_TASK.h"
+#include "NanoScript_FILTER.h"
+#include "NanoScript_PYRAMID.h"
+#include "NanoScript_ABORT.h"
+
+#include "windows.h" // for delay function
+#include "iostream" // for file manipulation
+#include "fstream"
+#include "math.h"
+#include <vector>
+using namespace std;
+
+struct RelaxorSample
+{
+	double t;			// planned time, seconds after the pulse
+	double amp;
+	bool rejected;
+};
+
+// Shared by the record task and the idle jobs; all run on the macro thread
+struct RelaxorRun
+{
+	vector<RelaxorSample> samples;
+	size_t written, fitted;
+	bool stop;
+	double sn, sx, sy, sxx, sxy;		// sums for amp = a + b ln(t)
+};
+
+static LithoTask Record(LithoScheduler& s, RelaxorRun& run, double Pulse_voltage, double Pulse_time, double wait,
+						double Interval, double Record_time, int Filter_window, double Filter_threshold)
+{
+	LithoHampelFilter glitch(Filter_window, Filter_threshold);
+	co_await s.Pulse(lsBias, 1000*Pulse_voltage, Pulse_time);
+	co_await s.Sleep(wait);
+	double t0 = LithoNow();
+	for (long i=0; !run.stop && i*Interval<=Record_time; i++)
+	{
+		double raw = co_await s.ReadAt(t0 + i*Interval, lsNS5FPOutput2);
+		RelaxorSample x = { i*Interval, glitch.Filter(raw), glitch.LastRejected() };
+		run.samples.push_back(x);
+	}
+}
+
+extern "C" __declspec(dllexport) int macroMain()
+{
+
+	//===========================================================================================================================
+	//												Relaxation after a pulse
+	//===========================================================================================================================
+	// Parameters with default values
+	double Pulse_voltage = 7;					// Volts, Pulse_time and wait are read from Relaxor_settings.txt as in Relaxor Char.cpp
+	double Pulse_time = 1;						// pulse duration (seconds)
+	double wait = 0;							// wait time after pulse (seconds)
+	double Interval = 0.01;						// time between samples (seconds)
+	double Record_time = 600;					// record at most this long (seconds)
+	double Settings_poll = 0.2;					// read the stop flag this often (seconds)
+	int Write_block = 200;						// samples written per idle call
+	double Write_secs = 0.005;					// longest expected idle call: writing a block (seconds)
+	double Fit_secs = 0.005;					// adding the new samples to the fit (seconds)
+	double Poll_secs = 0.002;					// reading the stop flag (seconds)
+	int Filter_window = 9;						// glitch filter, see Relaxor Char.cpp
+	double Filter_threshold = 4;
+
+	LITHO_BEGIN
+
+	LithoScan(false);							// turn off scanning
+	LithoAbortChannel abortChannel;				// tools/AbortMacro
+
+	int Stop_flag = 0, Restart_flag = 0;
+	ifstream settings("Relaxor_settings.txt");
+	settings >> Stop_flag >> Restart_flag >> Pulse_time >> wait >> Pulse_voltage;
+	settings.close();
+
+	RelaxorRun run;
+	run.written = run.fitted = 0;
+	run.stop = false;
+	run.sn = run.sx = run.sy = run.sxx = run.sxy = 0;
+	run.samples.reserve(size_t(Record_time / Interval) + 2);
+
+	ofstream myfile1("Relaxor Async.txt");
+	LithoPyramidWriter pyramid;
+	pyramid.Create("Relaxor Async");
+
+	LithoScheduler s;
+	s.Spawn(Record(s, run, Pulse_voltage, Pulse_time, wait, Interval, Record_time, Filter_window, Filter_threshold));
+
+	// write out what was recorded
+	s.Idle([&]() -> bool {
+		size_t end = run.samples.size();
+		if (end > run.written + Write_block)
+			end = run.written + Write_block;
+		if (end == run.written)
+			return false;
+		for (; run.written<end; run.written++)
+		{
+			const RelaxorSample& x = run.samples[run.written];
+			myfile1 << x.t << "\t" << x.amp << "\t" << x.rejected << "\n";
+			pyramid.Add(x.t, x.amp);
+		}
+		return true;
+	}, Write_secs);
+
+	// online fit of the relaxation, amp = a + b ln(t)
+	s.Idle([&]() -> bool {
+		if (run.fitted == run.samples.size())
+			return false;
+		for (; run.fitted<run.samples.size(); run.fitted++)
+		{
+			const RelaxorSample& x = run.samples[run.fitted];
+			if (x.t <= 0 || x.rejected)
+				continue;
+			double lx = log(x.t);
+			run.sn++;
+			run.sx += lx;
+			run.sy += x.amp;
+			run.sxx += lx*lx;
+			run.sxy += lx*x.amp;
+		}
+		return true;
+	}, Fit_secs);
+
+	// stop flag, as Relaxor Char.cpp reads it
+	double next_poll = LithoNow();
+	s.Idle([&]() -> bool {
+		if (LithoNow() < next_poll)
+			return false;
+		next_poll = LithoNow() + Settings_poll;
+		ifstream f("Relaxor_settings.txt");
+		int stop = 0;
+		if (f >> stop && stop != 0)
+			run.stop = true;
+		return true;
+	}, Poll_secs);
+
+	s.Run();
+
+	// what the idle jobs did not get to
+	for (; run.written<run.samples.size(); run.written++)
+	{
+		const RelaxorSample& x = run.samples[run.written];
+		myfile1 << x.t << "\t" << x.amp << "\t" << x.rejected << "\n";
+		pyramid.Add(x.t, x.amp);
+	}
+	pyramid.Close();
+
+	double det = run.sn*run.sxx - run.sx*run.sx;
+	double b = det != 0 ? (run.sn*run.sxy - run.sx*run.sy) / det : 0;
+	double a = run.sn > 0 ? (run.sy - b*run.sx) / run.sn : 0;
+	const LithoTimingStats& late = s.Lateness();
+	myfile1 << "# fit amp = a + b ln(t)\ta " << a << "\tb " << b << "\tpoints " << run.sn << "\n";
+	myfile1 << "# samples " << run.samples.size() << "\tlate mean (s) " << late.Mean() << "\tmax " << late.Max() << "\n";
+	myfile1 << "# idle calls " << s.IdleCalls() << "\tidle time (s) " << s.IdleSecs() << "\n";
+	myfile1.close();
+
+	LithoSetZero(lsNS5FPOutput1);
+	Beep(400,1000);
+	//======================================================================================================================================================
+
+	LITHO_END
+
+	return 0;	// 0 makes the macro unload. Return 1 to keep the macro loaded.
+}
@@ -4,6 +4,10 @@
 
 #include "NanoScript_GUI.h"
 #include "NanoScript_Litho.h"
+#include "NanoScript_LIMITS.h"
+#include "NanoScript_FILTER.h"
+#include "NanoScript_PYRAMID.h"
+#include "NanoScript_ABORT.h"
 
 //by Zhiyong
 #include "windows.h" // for delay function
@@ -36,6 +40,8 @@ extern "C" __declspec(dllexport) int macroMain()
     double Pulse_time = 1;                             // Pulse duration
     double wait=0;                                 // Wait time after pulse
 	double Amp=0;
+	int Filter_window=9;                           // Glitch filter: samples in the window
+	double Filter_threshold=4;                     // Glitch filter: rejection threshold (robust standard deviations)
 	//double current_time=11.2154;
 	LITHO_BEGIN
        
@@ -44,8 +50,12 @@ extern "C" __declspec(dllexport) int macroMain()
 	ofstream myfile1;
 	ofstream myfile2; 
 	clock_t begin_time = clock();
+	LithoHampelFilter glitch(Filter_window,Filter_threshold);	// replaces the spurious zeros of lsNS5FPOutput2 inline, no re-reads
+	LithoPyramidWriter pyramid;						// min/max/mean summaries next to Relaxor.txt, see tools/PyramidView
+	LithoAbortChannel abortChannel;						// tools/AbortMacro stops the macro at once, outputs at zero
     clock_t now_time=0;
 RESTART:
+	abortChannel.Check();
 	// Start reading settings from text file
     myfile.open("Relaxor_settings.txt");
 	myfile >> Stop_flag;
@@ -65,20 +75,24 @@ RESTART:
 	if (Restart_flag==1) 
 	{	
 		myfile1.open("Relaxor.txt");
+		pyramid.Create("Relaxor");
 		
 		myfile2.open("Relaxor_settings.txt");
 		myfile2 << Stop_flag <<"\t" << 0 << "\t"<< Pulse_time <<"\t" << wait << "\t" << Pulse_voltage;
 		myfile2.close();
-		LithoPulse(lsBias,1000*Pulse_voltage,Pulse_time);
+		LithoPulseLimited(lsBias,1000*Pulse_voltage,Pulse_time);	// refused and logged outside the session limits
 		//LithoSetSoft(lsNS5FPOutput1,Pulse_voltage);
 		//Sleep(1000*Pulse_time);
 		//LithoSetSoft(lsNS5FPOutput1,0);
-		Sleep(1000*wait);
+		LithoWaitUntil(LithoNow()+wait);		// ends early on an abort request
 		begin_time = clock();
+		glitch.Clear();
 record:
-		Amp=LithoGetSoft(lsNS5FPOutput2);
+		abortChannel.Check();
+		Amp=glitch.Filter(LithoGetSoft(lsNS5FPOutput2));
 		double now_time=((double)clock()-(double)begin_time)/1000;
-		myfile1 << now_time <<"\t"<< Amp << "\n" ;
+		myfile1 << now_time <<"\t"<< Amp <<"\t"<< glitch.LastRejected() << "\n" ;
+		pyramid.Add(now_time,Amp);
 		myfile.open("Relaxor_settings.txt");
 		myfile >> Stop_flag;
 		myfile >> Restart_flag;
@@ -86,6 +100,7 @@ record:
 		if(Restart_flag==1)
 		{
 			myfile1.close();
+			pyramid.Close();
 			goto RESTART;
 
 		}
@@ -96,6 +111,7 @@ record:
 		else 
 		{
 			myfile1.close();
+			pyramid.Close();
 		}
 	}
 	else
@@ -104,7 +120,7 @@ record:
 
 	}
 	
-	LithoSetSoft(lsNS5FPOutput1,0);
+	LithoSetZero(lsNS5FPOutput1);
 	
 	Beep(400,1000);
 	//======================================================================================================================================================
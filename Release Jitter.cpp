@@ -0,0 +1,95 @@
+// Release Jitter.cpp
+// Measures the timing jitter of short pulses with and without LithoRelease(false)
+// Results go to "Release Jitter.txt"
+
+#include "NanoScript_GUI.h"
+#include "NanoScript_Litho.h"
+#include "NanoScript_LIMITS.h"
+#include "NanoScript_TIMING.h"
+#include "NanoScript_RELEASE.h"
+
+#include "windows.h" // for delay function
+#include "iostream" // for file manipulation
+#include "fstream"
+#include "math.h"
+using namespace std;
+
+// One block of pulses. Each pulse is timed twice:
+//  - the duration of the LithoPulse call
+//  - the width of a software pulse (LithoSet / LithoPause / LithoSet) measured between the two sets
+static void RunBlock(bool captured, int N, double Pulse_volt, double Pulse_width,
+					 LithoTimingStats& callStats, LithoTimingStats& widthStats, ofstream& raw)
+{
+	for (int i=0; i<N; i++)
+	{
+		double call_time;
+		double width;
+		{
+			LithoCriticalSection cs(captured);		// only the pulses themselves are captured
+
+			LithoStopwatch sw;
+			LithoPulseLimited(lsBias, 1000*Pulse_volt, Pulse_width);
+			call_time = sw.Elapsed();
+
+			sw.Restart();
+			LithoSetLimited(lsBias, 1000*Pulse_volt);
+			LithoPause(Pulse_width);
+			LithoSetZero(lsBias, false);
+			width = sw.Elapsed();
+		}
+		callStats.Add(call_time);
+		widthStats.Add(width);
+		raw << captured << "\t" << i << "\t" << call_time << "\t" << width << "\n";
+		Sleep(10);									// let the GUI breathe between pulses
+	}
+}
+
+extern "C" __declspec(dllexport) int macroMain()
+{
+
+	//===========================================================================================================================
+	//												Pulse timing jitter
+	//===========================================================================================================================
+	// Parameters with default values
+	int N = 200;								// pulses per block
+	int Blocks = 5;								// blocks per mode, modes are interleaved to cancel drifts
+	double Pulse_volt = 0;						// pulse amplitude (Volts). 0 keeps the sample untouched
+	double Pulse_width = 0.005;					// pulse width (seconds)
+
+	LITHO_BEGIN
+
+	LithoScan(false);							// turn off scanning
+	if (!LithoLimits().CheckPulse(lsBias, 1000*Pulse_volt, false))
+		return 0;								// outside the session limits, logged: nothing to time
+
+	LithoTimingStats callStats[2];
+	LithoTimingStats widthStats[2];
+	ofstream myfile1;
+	myfile1.open("Release Jitter.txt");
+	myfile1 << "captured\tpulse\tLithoPulse call (s)\tsoftware pulse width (s)\n";
+
+	for (int b=0; b<Blocks; b++)
+	{
+		RunBlock(false, N, Pulse_volt, Pulse_width, callStats[0], widthStats[0], myfile1);
+		RunBlock(true, N, Pulse_volt, Pulse_width, callStats[1], widthStats[1], myfile1);
+	}
+
+	myfile1 << "\n# mode\tmeasure\tcount\tmean\tstddev\tmin\tmax\n";
+	for (int m=0; m<2; m++)
+	{
+		const char* mode = m ? "captured" : "released";
+		myfile1 << "# " << mode << "\tLithoPulse\t" << callStats[m].Count() << "\t" << callStats[m].Mean() << "\t"
+				<< callStats[m].StdDev() << "\t" << callStats[m].Min() << "\t" << callStats[m].Max() << "\n";
+		myfile1 << "# " << mode << "\twidth\t" << widthStats[m].Count() << "\t" << widthStats[m].Mean() << "\t"
+				<< widthStats[m].StdDev() << "\t" << widthStats[m].Min() << "\t" << widthStats[m].Max() << "\n";
+	}
+	myfile1.close();
+
+	LithoSetZero(lsBias, false);
+	Beep(400,1000);
+	//======================================================================================================================================================
+
+	LITHO_END
+
+	return 0;	// 0 makes the macro unload. Return 1 to keep the macro loaded.
+}
@@ -4,6 +4,7 @@
 
 #include "NanoScript_GUI.h"
 #include "NanoScript_Litho.h"
+#include "NanoScript_TRAIN.h"
 
 //by Zhiyong
 #include "windows.h" // for delay function
@@ -88,13 +89,19 @@ extern "C" __declspec(dllexport) int macroMain()
 
 	myfile1.close();*/
 
-	for (int ii=0;ii<=2;ii++)
-	{
-	LithoSetSoft(lsBias,1000);
-	Sleep(20000);
-	LithoSetSoft(lsBias,0);
-	Sleep(500);
-	}
+	// 3 bias pulses of 1 V, 20 s on / 0.5 s off, edges planned from the start of the train
+	double amp[3] = {1000,1000,1000}, width[3] = {20,20,20}, gap[3] = {0.5,0.5,0.5};
+	LithoTrainEdge edges[6];
+	bool applied=LithoPulseTrain(lsBias,amp,width,gap,3,edges);
+
+	ofstream train;
+	train.open("Bias train.txt");
+	train << "#planned_s\tactual_s\tuncertainty_s\tbias_mV\n";
+	if (!applied)
+		train << "#train stopped: refused by the limits or a set failed\n";
+	for (int e=0;e<6 && edges[e].actual==edges[e].actual;e++)		// only the edges that were applied
+		train << edges[e].planned << "\t" << edges[e].actual << "\t" << edges[e].uncertainty << "\t" << edges[e].value << "\n";
+	train.close();
 
 	Beep(400,1000);
 	//======================================================================================================================================================
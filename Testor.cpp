@@ -4,6 +4,10 @@
 
 #include "NanoScript_GUI.h"
 #include "NanoScript_Litho.h"
+#include "NanoScript_LIMITS.h"
+#include "NanoScript_INSTRUMENT.h"
+#include "NanoScript_FORC.h"
+#include "NanoScript_SSPFM.h"
 
 //by Zhiyong
 #include "windows.h" // for delay function
@@ -29,6 +33,15 @@ extern "C" __declspec(dllexport) int macroMain()
 	double Amp = 0;
 	double Phase =0;
 	double Amplitude= 0;
+	bool Forc_mode=false;						// first order reversal curves instead, see NanoScript_FORC.h
+	double Forc_saturation=8;					// FORC: saturation field, top of every curve (Volts)
+	double Forc_step=0.1;						// FORC: field step along the curves (Volts)
+	double Forc_reversal_step=0.2;				// FORC: spacing of the reversal fields (Volts)
+	bool Sspfm_mode=false;						// switching spectroscopy instead, see NanoScript_SSPFM.h
+	double Sspfm_max=8;							// SS-PFM: top of the triangle (Volts)
+	int Sspfm_steps=20;							// SS-PFM: steps from 0 to Sspfm_max
+	double Sspfm_segment=0.05;					// SS-PFM: length of each on-field and off-field segment (seconds)
+	int Sspfm_reads=8;							// SS-PFM: amplitude and phase reads per segment
 
 	/*ifstream myfile;		   					// Start reading settings from text file
     myfile.open("Untitled_settings.txt");
@@ -141,9 +154,67 @@ checkzero:
 	//myfile1.close();
 	
 	
-	LithoSetSoft(lsNS5FPOutput1,2);
-	Sleep(2000);
-	LithoSetSoft(lsNS5FPOutput1,0);
+	if (Forc_mode)
+	{
+		// reversal curves into "Testor FORC.lds" (Vr x V, in-phase response in mV), distribution: tools/ForcDistribution
+		LithoScan(false);
+		ForcParams forc;
+		forc.vSat=Forc_saturation;
+		forc.step=Forc_step;
+		forc.pulse=Pulse_time;
+		forc.wait=Wait_time;
+		vector<double> reversals;
+		for (double vr=Forc_saturation-Forc_step; vr>=-Forc_saturation-1e-9; vr-=Forc_reversal_step)
+			reversals.push_back(vr);
+		ForcSchedule plan;
+		ForcBuildSchedule(forc,reversals,plan);
+		LithoDataset data;
+		ForcCreateDataset(data,"Testor FORC.lds",forc);
+		LithoHardware afm;
+		LithoStopwatch sw;
+		bool complete=RunForc(afm,forc,plan,data);
+		data.Close();
+		ofstream myfile2("Testor FORC.txt");
+		myfile2 << "curves\t" << plan.curves << "\ncomplete\t" << complete << "\n";
+		myfile2 << "pulses\t" << plan.pulses << "\ttextbook\t" << plan.naivePulses << "\n";
+		myfile2 << "dwell (s)\t" << plan.dwellSecs << "\ttextbook\t" << plan.naiveDwellSecs << "\n";
+		myfile2 << "total (s)\t" << sw.Elapsed() << "\n";
+		myfile2.close();
+	}
+	else if (Sspfm_mode)
+	{
+		// on-field and off-field loops of one triangle into "Testor SSPFM.txt"
+		LithoScan(false);
+		SspfmParams ss;
+		ss.vMax=Sspfm_max;
+		ss.steps=Sspfm_steps;
+		ss.onSecs=ss.offSecs=Sspfm_segment;
+		ss.reads=Sspfm_reads;
+		vector<double> fields;
+		SspfmBuildWaveform(ss,fields);
+		vector<SspfmPoint> loop;
+		LithoHardware afm;
+		bool complete=RunSspfm(afm,ss,fields,loop);
+		double late=0;
+		ofstream myfile3("Testor SSPFM.txt");
+		myfile3 << "#V\ton amp\ton pha\ton X\toff amp\toff pha\toff X\n";	// phases wrapped, -180 .. 180: switching jumps by 180 degrees
+		for (size_t i=0; i<loop.size(); i++)
+		{
+			const SspfmPoint& pt=loop[i];
+			myfile3 << pt.field << "\t" << pt.on.amplitude << "\t" << pt.on.phase << "\t" << pt.on.x;
+			myfile3 << "\t" << pt.off.amplitude << "\t" << pt.off.phase << "\t" << pt.off.x << "\n";
+			if (pt.late>late)
+				late=pt.late;
+		}
+		myfile3 << "# steps " << loop.size() << " of " << fields.size() << "\tcomplete " << complete << "\tlate max (s) " << late << "\n";
+		myfile3.close();
+	}
+	else
+	{
+		LithoSetSoftLimited(lsNS5FPOutput1,2);
+		Sleep(2000);
+	}
+	LithoSetZero(lsNS5FPOutput1);
 	Beep(400,1000);
 	//======================================================================================================================================================
 	
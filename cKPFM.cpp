@@ -4,6 +4,9 @@
 
 #include "NanoScript_GUI.h"
 #include "NanoScript_Litho.h"
+#include "NanoScript_LIMITS.h"
+#include "NanoScript_RELEASE.h"
+#include "NanoScript_TRIGGER.h"
 
 //by Zhiyong
 #include "windows.h" // for delay function
@@ -24,6 +27,7 @@ extern "C" __declspec(dllexport) int macroMain()
 	float V_step = 0.05f;	    // the voltage step
 	float pulse_dura=0.1f;          //the time of the pulse
 	float post_pulse_time=0.3f;    //the time wait until capture
+	bool sync_trigger=true;        //fire D0 at every pulse and D1 at every probe step for the external digitizer
 
 	LITHO_BEGIN	
 
@@ -62,42 +66,54 @@ while(1)
 		pulse_dura=0.1;
 		post_pulse_time=0.1;
 		myfile.open("A_zhiyong.txt");
+		LithoSyncLog sync(sync_trigger);	//trigger times are in seconds from here
 		while(V_now<=V_max)//sweep up
 		{			
-			LithoPulse(lsBias,1000*V_now,pulse_dura);
+			double t_pulse=sync.Mark(tlD0,V_now);
+			LithoPulseLimited(lsBias,1000*V_now,pulse_dura);
 			Sleep(post_pulse_time*1000);
-			myfile <<"\n" << V_now << "\n";
+			myfile <<"\n" << V_now << "\t" << t_pulse << "\n";
 			Vs_now=-2;
+			{
+			LithoCriticalSection cs;	// capture the process only for the read sweep
 			while(Vs_now<=Vs_max)
 			{
-				LithoSet(lsBias,1000*Vs_now);
+				LithoSetLimited(lsBias,1000*Vs_now);
+				double t_probe=sync.Mark(tlD1,Vs_now);
 				double amp=1000*LithoGetSoft(lsNS5FPOutput1);
-				myfile << Vs_now << "\t"<< amp << "\n";
+				myfile << Vs_now << "\t"<< amp << "\t" << t_probe << "\n";
 				Vs_now += Vs_step;
 			}
-			LithoSet(lsBias,0);
+			LithoSetZero(lsBias,false);
+			}
 			V_now=V_now+V_step;
 			Beep(300,100);
 		}
 		Beep(300,2500);
 		while(V_now>=-V_max)//sweep dn
 		{		
-			LithoPulse(lsBias,1000*V_now,pulse_dura);
+			double t_pulse=sync.Mark(tlD0,V_now);
+			LithoPulseLimited(lsBias,1000*V_now,pulse_dura);
 			Sleep(post_pulse_time*1000);
-			myfile <<"\n" << V_now << "\n";
+			myfile <<"\n" << V_now << "\t" << t_pulse << "\n";
 			Vs_now=-2;
+			{
+			LithoCriticalSection cs;	// capture the process only for the read sweep
 			while(Vs_now<=Vs_max)
 			{
-				LithoSet(lsBias,1000*Vs_now);
+				LithoSetLimited(lsBias,1000*Vs_now);
+				double t_probe=sync.Mark(tlD1,Vs_now);
 				double amp=1000*LithoGetSoft(lsNS5FPOutput1);
-				myfile << Vs_now << "\t"<< amp << "\n";
+				myfile << Vs_now << "\t"<< amp << "\t" << t_probe << "\n";
 				Vs_now += Vs_step;
 			}
-			LithoSet(lsBias,0);
+			LithoSetZero(lsBias,false);
+			}
 			V_now=V_now-V_step;
 			Beep(300,100);
 		}
 		myfile.close();
+		sync.WriteTable("A_zhiyong_steps.txt");	//step table for tools/TriggerAlign
 		Beep(300,1500);
 	}
 }
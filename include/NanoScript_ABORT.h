@@ -0,0 +1,277 @@
+/** \file NanoScript_ABORT.h
+*	\brief External abort of a running macro
+*
+*	LithoAbort ends a macro from inside, but nothing outside the macro can
+*	call it: long running macros (Relaxor Char.cpp, Piezoreponse.cpp) are
+*	stopped by editing a settings file and waiting until the macro happens
+*	to read it again. LithoAbortChannel creates a named event that any
+*	process can set (LithoRequestAbort, tools/AbortMacro.cpp). The macro
+*	checks it with Check(), and so does every wait built on LithoWaitUntil
+*	(LithoWaitSettled, LithoSweepAcquire, LithoPulseTrain, ...) while the
+*	channel exists.
+*
+*	On a request, Check() first sets the outputs to zero (lsBias and
+*	lsNS5FPOutput1 unless told otherwise), stamps the time, tells the
+*	requester, and only then calls LithoAbort, so the outputs are safe
+*	whatever the macro does on its way out.
+*
+*	The time from request to safe outputs is kept in a small shared
+*	memory block next to the event, so both sides can read it. It is
+*	bounded by the longest call between two checks: a blocking LithoPulse
+*	or LithoPause is not interrupted. See "Abort Latency.cpp".
+*
+*	example:
+*
+*	LITHO_BEGIN
+*	LithoAbortChannel abortChannel;
+*	while (...)
+*	{
+*		abortChannel.Check();
+*		LithoPulse(lsBias, 1000*v, 0.1);
+*		LithoWaitSettled(lsNS5FPOutput1, 0.0005, 0.3);	// checks too
+*	}
+*	LITHO_END
+*/
+
+#ifndef __NANOSCRIPT_ABORT_H__
+#define __NANOSCRIPT_ABORT_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "windows.h"
+#include "NanoScript_Litho.h"
+#include "NanoScript_GUI.h"
+#include "NanoScript_TIMING.h"
+#include "NanoScript_LIMITS.h"
+#include "stdio.h"
+
+#define LITHO_ABORT_NAME		"NanoScriptAbort"
+#define LITHO_ABORT_MAGIC		0x54524241u		// "ABRT"
+#define LITHO_ABORT_OUTPUTS		8				// outputs set to zero at most
+
+
+/// Shared memory next to the abort event
+struct LithoAbortState
+{
+	unsigned int		magic;
+	volatile LONG		requests;		///< requests made so far
+	volatile LONG		handled;		///< requests handled so far
+	double				requested;		///< LithoNow() of the last request
+	double				safe;			///< LithoNow() when the outputs were at zero after it
+};
+
+
+/// Names of the objects of an abort channel
+inline void LithoAbortObjectName(const char* channel, const char* kind, char* name, size_t size)
+{
+	_snprintf(name, size, "Local\\%s_%s", channel, kind);
+	name[size - 1] = 0;
+}
+
+
+/// Thrown instead of calling LithoAbort by a channel made with callLithoAbort \c FALSE
+struct LithoAbortRequest
+{
+	double latency;				///< seconds from the request to safe outputs
+};
+
+
+/** \brief Receives abort requests in the macro
+*
+* While it exists, the channel is the one checked by LithoCheckAbort and
+* by LithoWaitUntil. Make one per macro, after LITHO_BEGIN.
+*/
+class LithoAbortChannel
+{
+public:
+	/** \param callLithoAbort End the macro with LithoAbort (\c TRUE), or throw
+	* a LithoAbortRequest the macro catches itself (\c FALSE, for benchmarks).
+	* \param channel Name of the channel, the requester uses the same name.
+	*/
+	explicit LithoAbortChannel(bool callLithoAbort = true, const char* channel = LITHO_ABORT_NAME) :
+		request(0), done(0), mapping(0), state(0), nOutputs(0), useLithoAbort(callLithoAbort), previous(Current())
+	{
+		char name[128];
+		LithoAbortObjectName(channel, "request", name, sizeof(name));
+		request = CreateEventA(0, TRUE, FALSE, name);
+		LithoAbortObjectName(channel, "done", name, sizeof(name));
+		done = CreateEventA(0, TRUE, FALSE, name);
+		LithoAbortObjectName(channel, "state", name, sizeof(name));
+		mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE, 0, sizeof(LithoAbortState), name);
+		if (mapping)
+			state = (LithoAbortState*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(LithoAbortState));
+		if (state)
+			state->magic = LITHO_ABORT_MAGIC;
+		if (request)
+			ResetEvent(request);		// a request left over from before this macro does not count
+		if (done)
+			ResetEvent(done);
+		AddOutput(lsBias);
+		AddOutput(lsNS5FPOutput1);
+		Current() = this;
+		LithoWaitCheck() = &LithoAbortChannel::Hook;
+	}
+
+	~LithoAbortChannel()
+	{
+		Current() = previous;
+		LithoWaitCheck() = previous ? &LithoAbortChannel::Hook : 0;
+		if (state)
+			UnmapViewOfFile(state);
+		if (mapping)
+			CloseHandle(mapping);
+		if (done)
+			CloseHandle(done);
+		if (request)
+			CloseHandle(request);
+	}
+
+	/// \c TRUE if the event could be created
+	bool IsOpen() const { return request != 0; }
+
+	/// Add an output set to zero on abort, besides lsBias and lsNS5FPOutput1
+	void AddOutput(LithoSignal output)
+	{
+		if (nOutputs < LITHO_ABORT_OUTPUTS)
+			outputs[nOutputs++] = output;
+	}
+
+	/// \c TRUE if an abort was requested and not handled yet
+	bool Requested() const
+	{
+		return request && WaitForSingleObject(request, 0) == WAIT_OBJECT_0;
+	}
+
+	/** \brief Handle a pending request: outputs to zero, then LithoAbort
+	*
+	* Does nothing and returns at once (one kernel call) if there is none.
+	*/
+	void Check()
+	{
+		if (!Requested())
+			return;
+		SafeState();
+		double now = LithoNow();
+		double latency = 0;
+		ResetEvent(request);
+		if (state)
+		{
+			state->safe = now;
+			latency = now - state->requested;
+			MemoryBarrier();
+			InterlockedIncrement(&state->handled);
+		}
+		SetEvent(done);
+
+		char msg[128];
+		_snprintf(msg, sizeof(msg), "Abort requested, outputs at zero after %.1f ms", 1000 * latency);
+		msg[sizeof(msg) - 1] = 0;
+		WriteMsg2Log(1, msg);
+
+		if (!useLithoAbort)
+		{
+			LithoAbortRequest r = { latency };
+			throw r;
+		}
+		LithoAbort();
+		throw LithoException("aborted");		// in case LithoAbort returns
+	}
+
+	/// Set the outputs to zero
+	void SafeState()
+	{
+		for (int i=0; i<nOutputs; i++)
+			LithoSetZero(outputs[i]);
+	}
+
+	/// Seconds from the last request to safe outputs, 0 if none was handled
+	double Latency() const
+	{
+		return state && state->handled > 0 ? state->safe - state->requested : 0;
+	}
+
+	/// The channel checked by LithoCheckAbort, 0 if none
+	static LithoAbortChannel*& Current()
+	{
+		static LithoAbortChannel* current = 0;
+		return current;
+	}
+
+private:
+	LithoAbortChannel(const LithoAbortChannel&);
+	LithoAbortChannel& operator=(const LithoAbortChannel&);
+
+	static void Hook()
+	{
+		if (Current())
+			Current()->Check();
+	}
+
+	HANDLE request, done, mapping;
+	LithoAbortState* state;
+	LithoSignal outputs[LITHO_ABORT_OUTPUTS];
+	int nOutputs;
+	bool useLithoAbort;
+	LithoAbortChannel* previous;
+};
+
+
+/// Handle a pending abort request on the current channel, if there is one
+inline void LithoCheckAbort()
+{
+	if (LithoAbortChannel::Current())
+		LithoAbortChannel::Current()->Check();
+}
+
+
+/** \brief Ask the macro holding a channel to abort; usable from any process
+*
+* \param latency If not 0, waits for the macro and receives the seconds
+* from the request to safe outputs, as measured by the macro.
+* \param timeout Seconds to wait for the macro.
+* \param channel Name of the channel.
+*
+* \return \c FALSE if no macro holds the channel, or it did not answer in time.
+*/
+inline bool LithoRequestAbort(double* latency = 0, double timeout = 5, const char* channel = LITHO_ABORT_NAME)
+{
+	char name[128];
+	LithoAbortObjectName(channel, "request", name, sizeof(name));
+	HANDLE request = OpenEventA(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, name);
+	if (!request)
+		return false;
+	LithoAbortObjectName(channel, "done", name, sizeof(name));
+	HANDLE done = OpenEventA(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, name);
+	LithoAbortObjectName(channel, "state", name, sizeof(name));
+	HANDLE mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+	LithoAbortState* state = mapping ? (LithoAbortState*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0) : 0;
+
+	LONG handled = state ? state->handled : 0;
+	if (done)
+		ResetEvent(done);
+	if (state)
+	{
+		state->requested = LithoNow();
+		MemoryBarrier();
+		InterlockedIncrement(&state->requests);
+	}
+	bool ok = SetEvent(request) != 0;
+
+	if (ok && latency)
+	{
+		ok = done && WaitForSingleObject(done, (DWORD)(1000 * timeout)) == WAIT_OBJECT_0;
+		*latency = ok && state && state->handled != handled ? state->safe - state->requested : 0;
+	}
+	if (state)
+		UnmapViewOfFile(state);
+	if (mapping)
+		CloseHandle(mapping);
+	if (done)
+		CloseHandle(done);
+	CloseHandle(request);
+	return ok;
+}
+
+#endif // __NANOSCRIPT_ABORT_H__
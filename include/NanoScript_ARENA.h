@@ -0,0 +1,218 @@
+/** \file NanoScript_ARENA.h
+*	\brief Monotonic arena for per-step sample buffers
+*
+*	Buffers created inside a sweep loop (std::vector or new[]) go to the
+*	heap on every step, and a heap allocation can take longer than the read
+*	it is made for. LithoArena hands out memory from a few large blocks
+*	by moving a pointer, and gives all of it back at once at the end of the
+*	step. Once the first step has grown the arena to its working size, the
+*	following steps take no more blocks from the heap; HeapAllocations()
+*	counts the blocks taken.
+*
+*	The buffer classes count the heap allocations they make in one counter
+*	(LithoHeapCounter): the blocks of every LithoArena and the chunk buffers
+*	of LithoDataset (NanoScript_DATASET.h). LithoHeapCheck reads it before
+*	and after a step, so a loop can check that its buffers stopped growing.
+*	Other heap use, e.g. a std::vector of the macro, is not seen.
+*
+*	example:
+*
+*	LithoArena arena(1 << 20);
+*	for (k...)
+*	{
+*		LithoArenaScope step(arena);			// everything below is freed at the end of the step
+*		double* t = arena.Alloc<double>(n);
+*		double* v = arena.Alloc<double>(n);
+*		...
+*	}
+*	// arena.HeapAllocations() == 1 if 1 MB was enough for a step
+*
+*	Only plain data (no destructors) should be put in the arena, destructors
+*	are not called.
+*/
+
+#ifndef __NANOSCRIPT_ARENA_H__
+#define __NANOSCRIPT_ARENA_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "stdlib.h"
+#include <atomic>
+#include <new>
+#include <vector>
+
+
+/// Heap allocations of the buffer classes so far, see the file description
+inline std::atomic<long>& LithoHeapCounter()
+{
+	static std::atomic<long> calls(0);
+	return calls;
+}
+
+
+/** \brief Heap allocations of the buffer classes since construction
+*
+* example:
+*
+* LithoHeapCheck check;
+* ...												// the sweep
+* if (check.Allocations() > 0) ...
+*/
+class LithoHeapCheck
+{
+public:
+	LithoHeapCheck() : start(LithoHeapCounter()) {}
+
+	/// Arena blocks and dataset chunk buffers allocated since construction
+	long Allocations() const { return LithoHeapCounter() - start; }
+
+private:
+	long start;
+};
+
+
+/// Monotonic arena, see the file description
+class LithoArena
+{
+public:
+	/** \param blockBytes Size of the blocks taken from the heap. Requests
+	* larger than this get a block of their own.
+	*/
+	explicit LithoArena(size_t blockBytes = 1 << 20) : blockSize(blockBytes), current(0), used(0), peak(0), heap(0)
+	{
+		blocks.reserve(16);
+	}
+
+	~LithoArena()
+	{
+		for (size_t i=0; i<blocks.size(); i++)
+			free(blocks[i].base);
+	}
+
+	/// Position of the arena, for Reset()
+	struct Mark
+	{
+		size_t block;
+		size_t offset;
+		size_t used;
+	};
+
+	/// Uninitialized storage for \p n objects of type T
+	template <class T>
+	T* Alloc(size_t n)
+	{
+		return (T*)Allocate(n * sizeof(T), alignof(T) > 8 ? alignof(T) : 8);
+	}
+
+	/// Storage for \p bytes bytes, aligned to \p align (a power of two)
+	void* Allocate(size_t bytes, size_t align = 8)
+	{
+		while (current < blocks.size())
+		{
+			Block& b = blocks[current];
+			size_t start = (b.offset + align - 1) & ~(align - 1);
+			if (start + bytes <= b.size)
+			{
+				used += start + bytes - b.offset;
+				b.offset = start + bytes;
+				if (used > peak)
+					peak = used;
+				return b.base + start;
+			}
+			// the rest of this block stays unused until the next reset
+			if (current + 1 == blocks.size())
+				break;
+			current++;
+			blocks[current].offset = 0;
+		}
+		Block b;
+		b.size = bytes + align > blockSize ? bytes + align : blockSize;
+		b.base = (char*)malloc(b.size);
+		if (!b.base)
+			throw std::bad_alloc();
+		b.offset = 0;
+		heap++;
+		LithoHeapCounter()++;
+		blocks.push_back(b);
+		current = blocks.size() - 1;
+		return Allocate(bytes, align);
+	}
+
+	/// Take the blocks for \p bytes from the heap now, so that the first step does not
+	void Reserve(size_t bytes)
+	{
+		Mark m = Position();
+		Allocate(bytes);
+		Reset(m);
+	}
+
+	/// Current position
+	Mark Position() const
+	{
+		Mark m;
+		m.block = current;
+		m.offset = current < blocks.size() ? blocks[current].offset : 0;
+		m.used = used;
+		return m;
+	}
+
+	/// Free everything allocated after \p m; the blocks are kept for reuse
+	void Reset(const Mark& m)
+	{
+		current = m.block;
+		if (current < blocks.size())
+			blocks[current].offset = m.offset;
+		used = m.used;
+	}
+
+	/// Free everything; the blocks are kept for reuse
+	void Reset()
+	{
+		current = 0;
+		if (!blocks.empty())
+			blocks[0].offset = 0;
+		used = 0;
+	}
+
+	size_t	Used() const			{ return used; }				///< bytes in use, alignment included
+	size_t	Peak() const			{ return peak; }				///< most bytes ever in use
+	size_t	Capacity() const		{ size_t c = 0; for (size_t i=0; i<blocks.size(); i++) c += blocks[i].size; return c; }
+	long	HeapAllocations() const	{ return heap; }				///< blocks taken from the heap so far
+
+private:
+	LithoArena(const LithoArena&);
+	LithoArena& operator=(const LithoArena&);
+
+	struct Block
+	{
+		char* base;
+		size_t size;
+		size_t offset;
+	};
+
+	size_t blockSize;
+	std::vector<Block> blocks;
+	size_t current;
+	size_t used, peak;
+	long heap;
+};
+
+
+/// Frees what was allocated in the arena during the lifetime of the scope
+class LithoArenaScope
+{
+public:
+	explicit LithoArenaScope(LithoArena& a) : arena(a), mark(a.Position()) {}
+	~LithoArenaScope() { arena.Reset(mark); }
+
+private:
+	LithoArenaScope(const LithoArenaScope&);
+	LithoArenaScope& operator=(const LithoArenaScope&);
+
+	LithoArena& arena;
+	LithoArena::Mark mark;
+};
+
+#endif // __NANOSCRIPT_ARENA_H__
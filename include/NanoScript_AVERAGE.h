@@ -0,0 +1,100 @@
+/** \file NanoScript_AVERAGE.h
+*	\brief Averaging that stops when the mean is known well enough
+*
+*	A fixed number of reads per point is too many on a clean sample and too
+*	few on a noisy one. LithoAverageUntil keeps reading until the standard
+*	error of the mean is below a target, between a minimum and a maximum
+*	number of reads, so the time spent averaging follows the noise actually
+*	present.
+*
+*	example:
+*
+*	LithoAverage a = LithoAverageUntil(lsNS5FPOutput1, 0.0002, 3, 30);
+*	myfile << a.mean << "\t" << a.sem << "\t" << a.count;
+*
+*	Any callable returning a double can be averaged, e.g. a channel read
+*	through NanoScript_SIGNALS.h:
+*
+*	LithoAverage amp = LithoAverageUntil([]{ return LithoReadChannel<PfmAmplitude>().value; }, 0.2, 3, 30);
+*/
+
+#ifndef __NANOSCRIPT_AVERAGE_H__
+#define __NANOSCRIPT_AVERAGE_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include "math.h"
+
+
+/// Outcome of LithoAverageUntil
+struct LithoAverage
+{
+	double	mean;
+	double	sem;			///< standard error of the mean; 0 if fewer than two reads
+	double	stddev;			///< standard deviation of the reads
+	int		count;			///< reads taken
+	bool	reached;		///< \c TRUE if the target was met before maxReads
+};
+
+
+/** \brief Read until the standard error of the mean is at most \p targetSem
+*
+* \param read Callable returning one reading.
+* \param targetSem Target standard error, in the units of the reading.
+* \param minReads Reads taken in any case (at least 2, so the scatter is known).
+* \param maxReads Reads taken at most, whatever the noise.
+*/
+template <class Read>
+LithoAverage LithoAverageUntil(Read read, double targetSem, int minReads = 3, int maxReads = 30)
+{
+	if (minReads < 2)
+		minReads = 2;
+	if (maxReads < minReads)
+		maxReads = minReads;
+	LithoAverage a;
+	a.mean = a.sem = a.stddev = 0;
+	a.count = 0;
+	a.reached = false;
+	double m2 = 0;
+	while (a.count < maxReads)
+	{
+		double x = read();
+		a.count++;
+		double d = x - a.mean;
+		a.mean += d / a.count;
+		m2 += d * (x - a.mean);
+		if (a.count < 2)
+			continue;
+		a.stddev = sqrt(m2 / (a.count - 1));
+		a.sem = a.stddev / sqrt((double)a.count);
+		if (a.count >= minReads && a.sem <= targetSem)
+		{
+			a.reached = true;
+			break;
+		}
+	}
+	return a;
+}
+
+
+/// Helper for LithoAverageUntil on a signal
+struct LithoSignalReader
+{
+	LithoSignal signal;
+	bool soft;
+	double operator()() const { return soft ? LithoGetSoft(signal) : LithoGet(signal); }
+};
+
+
+/// Average a signal, in soft (\c TRUE) or hard units, see LithoAverageUntil above
+inline LithoAverage LithoAverageUntil(LithoSignal input, double targetSem, int minReads = 3, int maxReads = 30,
+									  bool soft = true)
+{
+	LithoSignalReader r = { input, soft };
+	return LithoAverageUntil(r, targetSem, minReads, maxReads);
+}
+
+#endif // __NANOSCRIPT_AVERAGE_H__
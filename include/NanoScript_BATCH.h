@@ -0,0 +1,313 @@
+/** \file NanoScript_BATCH.h
+*	\brief Unattended queue of experiments
+*
+*	The GUI functions only offer modal dialogs, so parameters end up
+*	hard-coded in the macros and every run needs an operator. A batch queue
+*	is a text file listing experiments, one per line, which a macro runs
+*	back-to-back without any dialog. Progress goes to the Nanoscope log,
+*	timing and outcome of every job to a report file.
+*
+*	Queue file format:
+*
+*	\code
+*	# comment
+*	<experiment> [@x,y] [name=value ...]
+*	pfm_loop @10,20 V_max=8 V_step=0.1
+*	relaxor Pulse_voltage=7 Record_time=600
+*	\endcode
+*
+*	\c \@x,y moves the tip to the absolute position (microns, closed loop
+*	scanners only) before the experiment starts. Experiments are looked up by
+*	name in a table of BatchExperimentEntry given by the macro.
+*/
+
+#ifndef __NANOSCRIPT_BATCH_H__
+#define __NANOSCRIPT_BATCH_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include "NanoScript_GUI.h"
+#include "NanoScript_TIMING.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "fstream"
+#include "sstream"
+#include <map>
+#include <string>
+#include <vector>
+
+
+/// One line of the queue
+struct BatchJob
+{
+	int				index;			///< position in the queue, from 0
+	int				line;			///< line number in the queue file
+	std::string		experiment;
+	bool			hasPosition;
+	double			x, y;			///< target position in microns, if hasPosition
+	std::map<std::string, double>	params;
+
+	BatchJob() : index(0), line(0), hasPosition(false), x(0), y(0) {}
+
+	/// Parameter value, or \p def if the job does not set it
+	double Get(const char* name, double def) const
+	{
+		std::map<std::string, double>::const_iterator it = params.find(name);
+		return it == params.end() ? def : it->second;
+	}
+
+	/// Output file name for this job: Batch_<index>_<experiment><suffix>
+	std::string FileName(const char* suffix = ".txt") const
+	{
+		char buf[32];
+		sprintf(buf, "Batch_%03d_", index);
+		return buf + experiment + suffix;
+	}
+};
+
+
+/** \brief An experiment that can be queued
+*
+* \param job The job with its parameters.
+* \param message Set to a short description of the outcome for the report.
+*
+* \return \c TRUE on success.
+*/
+typedef bool (*BatchExperiment)(const BatchJob& job, std::string& message);
+
+
+/// Entry of the experiment table given to LithoRunBatch
+struct BatchExperimentEntry
+{
+	const char*		name;
+	BatchExperiment	run;
+};
+
+
+/// Outcome of one job
+struct BatchResult
+{
+	BatchJob		job;
+	bool			ok;
+	double			moveSecs;		///< time spent moving to the position
+	double			runSecs;		///< time spent in the experiment
+	std::string		message;
+};
+
+
+/** \brief Parse one queue line
+*
+* \param text The line, comments are stripped.
+* \param job Receives the experiment, position and parameters.
+* \param error Set to the word that could not be read, if any.
+*
+* \return \c TRUE if the line holds a job, \c FALSE if it is empty or malformed.
+*/
+inline bool LithoParseBatchLine(std::string text, BatchJob& job, std::string& error)
+{
+	size_t hash = text.find('#');
+	if (hash != std::string::npos)
+		text.erase(hash);
+	std::istringstream in(text);
+	error.clear();
+	if (!(in >> job.experiment))
+		return false;
+	std::string word;
+	while (in >> word)
+	{
+		bool ok;
+		if (word[0] == '@')
+		{
+			ok = sscanf(word.c_str() + 1, "%lf,%lf", &job.x, &job.y) == 2;
+			job.hasPosition = true;
+		}
+		else
+		{
+			size_t eq = word.find('=');
+			char* end = 0;
+			if (eq != std::string::npos)
+				job.params[word.substr(0, eq)] = strtod(word.c_str() + eq + 1, &end);
+			ok = eq != std::string::npos && end && *end == 0;
+		}
+		if (!ok)
+		{
+			error = word;
+			return false;
+		}
+	}
+	return true;
+}
+
+
+/** \brief Read a queue file
+*
+* Malformed lines are reported to the Nanoscope log and skipped.
+*
+* \return \c FALSE if the file could not be opened.
+*/
+inline bool LithoReadBatch(const char* fileName, std::vector<BatchJob>& jobs)
+{
+	std::ifstream f(fileName);
+	if (!f)
+		return false;
+	std::string text, error;
+	int line = 0;
+	while (std::getline(f, text))
+	{
+		line++;
+		BatchJob job;
+		job.line = line;
+		if (!LithoParseBatchLine(text, job, error))
+		{
+			if (!error.empty())
+			{
+				char msg[256];
+				_snprintf(msg, sizeof(msg), "Batch: %s line %d: cannot read '%s', job skipped", fileName, line, error.c_str());
+				msg[sizeof(msg) - 1] = 0;
+				WriteMsg2Log(1, msg);
+			}
+			continue;
+		}
+		job.index = (int)jobs.size();
+		jobs.push_back(job);
+	}
+	return true;
+}
+
+
+/** \brief Run a single job
+*
+* Moves to the job's position, looks up and runs the experiment and times
+* both. A LithoException (abort) is passed on to the caller.
+*/
+inline BatchResult LithoRunJob(const BatchJob& job, const BatchExperimentEntry* table, int tableSize,
+							   double rateUmPerSec)
+{
+	BatchResult r;
+	r.job = job;
+	r.ok = false;
+	r.moveSecs = r.runSecs = 0;
+
+	BatchExperiment run = 0;
+	for (int i=0; i<tableSize; i++)
+		if (job.experiment == table[i].name)
+			run = table[i].run;
+	if (!run)
+	{
+		r.message = "unknown experiment";
+		return r;
+	}
+
+	LithoStopwatch sw;
+	if (job.hasPosition && !LithoTranslateAbsolute(job.x, job.y, rateUmPerSec))
+	{
+		r.moveSecs = sw.Elapsed();
+		r.message = "move failed";
+		return r;
+	}
+	r.moveSecs = sw.Restart();
+	try
+	{
+		r.ok = run(job, r.message);
+	}
+	catch (LithoException&)
+	{
+		throw;
+	}
+	catch (std::exception& e)
+	{
+		r.message = std::string("exception: ") + e.what();
+	}
+	r.runSecs = sw.Elapsed();
+	return r;
+}
+
+
+/** \brief Write the report of a batch run
+*
+* One line per job, then a summary with the instrument utilization
+* (share of the wall time spent in experiments).
+*/
+inline void LithoWriteBatchReport(const char* fileName, const std::vector<BatchResult>& results, double wallSecs)
+{
+	std::ofstream f(fileName);
+	f << "#job\tline\texperiment\tx\ty\tok\tmove_s\trun_s\tmessage\n";
+	double run = 0, move = 0;
+	int ok = 0;
+	for (size_t i=0; i<results.size(); i++)
+	{
+		const BatchResult& r = results[i];
+		f << r.job.index << "\t" << r.job.line << "\t" << r.job.experiment << "\t";
+		if (r.job.hasPosition)
+			f << r.job.x << "\t" << r.job.y;
+		else
+			f << "-\t-";
+		f << "\t" << r.ok << "\t" << r.moveSecs << "\t" << r.runSecs << "\t" << r.message << "\n";
+		run += r.runSecs;
+		move += r.moveSecs;
+		ok += r.ok;
+	}
+	f << "\n# jobs " << results.size() << ", ok " << ok << ", failed " << results.size() - ok << "\n";
+	f << "# wall " << wallSecs << " s, experiments " << run << " s, moves " << move << " s\n";
+	f << "# utilization " << (wallSecs > 0 ? 100 * run / wallSecs : 0) << " %\n";
+}
+
+
+/** \brief Run every job of a queue file, without any dialog
+*
+* The report is rewritten after every job, so it is complete up to the
+* last finished job even if the batch is aborted.
+*
+* \param queueFile Queue file, see the file description.
+* \param reportFile Report file written by LithoWriteBatchReport.
+* \param table Experiments that can be queued.
+* \param tableSize Number of entries in \p table.
+* \param rateUmPerSec Tip speed for moves between positions.
+*
+* \return Number of jobs that succeeded, -1 if the queue could not be read.
+*/
+inline int LithoRunBatch(const char* queueFile, const char* reportFile, const BatchExperimentEntry* table,
+						 int tableSize, double rateUmPerSec = 5)
+{
+	std::vector<BatchJob> jobs;
+	if (!LithoReadBatch(queueFile, jobs))
+	{
+		WriteMsg2Log(2, "Batch: cannot open the queue file");
+		return -1;
+	}
+
+	std::vector<BatchResult> results;
+	LithoStopwatch wall;
+	int ok = 0;
+	for (size_t i=0; i<jobs.size(); i++)
+	{
+		char msg[256];
+		_snprintf(msg, sizeof(msg), "Batch: job %d of %d, %s", (int)i + 1, (int)jobs.size(), jobs[i].experiment.c_str());
+		msg[sizeof(msg) - 1] = 0;
+		WriteMsg2Log(0, msg);
+		try
+		{
+			results.push_back(LithoRunJob(jobs[i], table, tableSize, rateUmPerSec));
+		}
+		catch (LithoException&)
+		{
+			LithoWriteBatchReport(reportFile, results, wall.Elapsed());
+			throw;
+		}
+		const BatchResult& r = results.back();
+		ok += r.ok;
+		if (!r.ok)
+		{
+			_snprintf(msg, sizeof(msg), "Batch: job %d (%s) failed: %s", (int)i + 1, r.job.experiment.c_str(), r.message.c_str());
+			msg[sizeof(msg) - 1] = 0;
+			WriteMsg2Log(1, msg);
+		}
+		LithoWriteBatchReport(reportFile, results, wall.Elapsed());
+	}
+	return ok;
+}
+
+#endif // __NANOSCRIPT_BATCH_H__
@@ -0,0 +1,349 @@
+/** \file NanoScript_CALIB.h
+*	\brief Cached soft <-> hard unit conversion for hot loops
+*
+*	LithoSetSoft and LithoGetSoft convert between soft and hard units on
+*	every call. LithoCalibration measures the transfer of a signal once per
+*	session, so that inner loops can use LithoSet / LithoGet in hard units and
+*	convert whole blocks of samples afterwards.
+*
+*	A transfer that is linear to within the tolerance is stored as gain and
+*	offset. Otherwise the points of an output calibration, which are set
+*	and read back one at a time, are kept as a lookup table and
+*	interpolated piecewise linearly. Transfers measured from a live input
+*	signal are always fitted as a line: their points carry the noise of the
+*	signal, and a table through them would pass that noise on to every
+*	later conversion.
+*
+*	example:
+*
+*	LithoCalibration cal;
+*	if (!cal.Load("tip.cal"))						// saved by an earlier run
+*	{
+*		cal.CalibrateOutput(lsNS5FPOutput1, -2, 2);	// sets the output: lift the tip, stay in the safe range!
+*		cal.Save("tip.cal");
+*	}
+*	cal.CalibrateInput(lsNS5FPOutput2);
+*	double h = cal.ToHard(lsNS5FPOutput1, 1.5);
+*	for (int i=0; i<n; i++)
+*	{
+*		LithoSet(lsNS5FPOutput1, h);
+*		hard[i] = LithoGet(lsNS5FPOutput2);
+*	}
+*	cal.ToSoft(lsNS5FPOutput2, hard, soft, n);
+*/
+
+#ifndef __NANOSCRIPT_CALIB_H__
+#define __NANOSCRIPT_CALIB_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include "NanoScript_LIMITS.h"
+#include "math.h"
+#include "fstream"
+#include <algorithm>
+#include <vector>
+
+
+/// Measured transfer of one signal: soft = f(hard)
+struct LithoTransfer
+{
+	bool	valid;
+	bool	linear;					///< \c TRUE: soft = gain * hard + offset
+	double	gain, offset;
+	std::vector<double> hard, soft;	///< lookup table, sorted by hard value, if not linear
+	double	residual;				///< largest deviation of the points from the linear fit (soft units)
+
+	LithoTransfer() : valid(false), linear(true), gain(1), offset(0), residual(0) {}
+};
+
+
+/// Calibration cache for all signals, see the file description
+class LithoCalibration
+{
+public:
+	/** \param tolerance Largest deviation from a straight line, relative to
+	* the soft range, for which a transfer is stored as linear.
+	*/
+	explicit LithoCalibration(double tolerance = 1e-4) : tol(tolerance) {}
+
+	/** \brief Measure the transfer of an output
+	*
+	* The output is set to \p points soft values between \p softMin and
+	* \p softMax and read back in hard units. The previous value is restored
+	* afterwards.
+	*
+	* \warning The output really takes these values. Only use a range that
+	* is safe for the sample, with the tip lifted, or calibrate once and
+	* Load() the saved transfer; a range outside the session limits
+	* (NanoScript_LIMITS.h) is refused.
+	*
+	* \return \c TRUE if the transfer could be determined: the read back
+	* values must follow the set ones (correlation 0.99) with a gain other
+	* than 0.
+	*/
+	bool CalibrateOutput(LithoSignal output, double softMin, double softMax, int points = 9)
+	{
+		if (points < 2)
+			points = 2;
+		// the previous value is restored, like after a pulse
+		if (!LithoLimits().CheckPulse(output, softMin, true) || !LithoLimits().CheckPulse(output, softMax, true))
+			return false;
+		double previous = LithoGetSoft(output);
+		std::vector<double> h(points), s(points);
+		for (int i=0; i<points; i++)
+		{
+			s[i] = softMin + (softMax - softMin) * i / (points - 1);
+			LithoSetSoft(output, s[i]);
+			h[i] = LithoGet(output);
+		}
+		LithoSetSoft(output, previous);
+		return Fit(output, h, s, 0.99, true);
+	}
+
+	/** \brief Measure the transfer of an input
+	*
+	* Reads the input \p samples times in both unit systems. Each pair is read
+	* as hard, soft, soft, hard so that a linearly changing signal gives
+	* matching averages. The signal must vary over the samples (e.g. during a
+	* sweep) by much more than its noise for the gain and offset to be
+	* determined; otherwise the calibration fails. The transfer is stored as
+	* a line.
+	*
+	* \return \c TRUE if the transfer could be determined.
+	*/
+	bool CalibrateInput(LithoSignal input, int samples = 32)
+	{
+		std::vector<double> h(samples), s(samples);
+		for (int i=0; i<samples; i++)
+		{
+			double h1 = LithoGet(input);
+			double s1 = LithoGetSoft(input);
+			double s2 = LithoGetSoft(input);
+			double h2 = LithoGet(input);
+			h[i] = 0.5 * (h1 + h2);
+			s[i] = 0.5 * (s1 + s2);
+		}
+		return Fit(input, h, s, 0.99, false);
+	}
+
+	/** \brief Determine the transfer from (hard, soft) pairs measured by the macro
+	*
+	* Useful for inputs that only vary during the measurement itself: read
+	* the first sweep in both units, calibrate from it and read the following
+	* sweeps in hard units only. The pairs are read at slightly different
+	* moments of a changing signal, so the transfer is stored as the line
+	* fitted through them, however large their scatter.
+	*
+	* \return \c TRUE if the transfer could be determined.
+	*/
+	bool CalibratePairs(LithoSignal s, const double* hard, const double* soft, int n)
+	{
+		if (n < 2)
+			return false;
+		std::vector<double> h(hard, hard + n), v(soft, soft + n);
+		return Fit(s, h, v, 0.99, false);
+	}
+
+	/** \brief Set the transfer of a signal directly
+	*
+	* For signals whose conversion is known, e.g. from the head parameters.
+	*/
+	void SetLinear(LithoSignal s, double gain, double offset)
+	{
+		LithoTransfer& t = cache[s];
+		t = LithoTransfer();
+		t.valid = true;
+		t.gain = gain;
+		t.offset = offset;
+	}
+
+	bool IsCalibrated(LithoSignal s) const { return cache[s].valid; }
+
+	const LithoTransfer& Transfer(LithoSignal s) const { return cache[s]; }
+
+	/// Convert one value from hard to soft units
+	double ToSoft(LithoSignal s, double hard) const
+	{
+		const LithoTransfer& t = cache[s];
+		if (t.linear)
+			return t.gain * hard + t.offset;
+		return Interpolate(t.hard, t.soft, hard);
+	}
+
+	/// Convert one value from soft to hard units
+	double ToHard(LithoSignal s, double soft) const
+	{
+		const LithoTransfer& t = cache[s];
+		if (t.linear)
+			return (soft - t.offset) / t.gain;
+		return Interpolate(t.soft, t.hard, soft);
+	}
+
+	/// Convert a block of values from hard to soft units. \p hard and \p soft may be the same array.
+	void ToSoft(LithoSignal s, const double* hard, double* soft, int n) const
+	{
+		const LithoTransfer& t = cache[s];
+		if (t.linear)
+		{
+			const double g = t.gain, o = t.offset;
+			for (int i=0; i<n; i++)
+				soft[i] = g * hard[i] + o;
+		}
+		else
+			for (int i=0; i<n; i++)
+				soft[i] = Interpolate(t.hard, t.soft, hard[i]);
+	}
+
+	/// Convert a block of values from soft to hard units. \p soft and \p hard may be the same array.
+	void ToHard(LithoSignal s, const double* soft, double* hard, int n) const
+	{
+		const LithoTransfer& t = cache[s];
+		if (t.linear)
+		{
+			const double g = 1 / t.gain, o = t.offset;
+			for (int i=0; i<n; i++)
+				hard[i] = (soft[i] - o) * g;
+		}
+		else
+			for (int i=0; i<n; i++)
+				hard[i] = Interpolate(t.soft, t.hard, soft[i]);
+	}
+
+	/** \brief Save the calibrated transfers, to reuse them in a later run
+	*
+	* \return \c TRUE if the file could be written.
+	*/
+	bool Save(const char* fileName) const
+	{
+		std::ofstream f(fileName);
+		f.precision(17);
+		for (int s=0; s<lsCount; s++)
+		{
+			const LithoTransfer& t = cache[s];
+			if (!t.valid)
+				continue;
+			f << s << " " << t.linear << " " << t.gain << " " << t.offset << " " << t.residual << " " << t.hard.size();
+			for (size_t i=0; i<t.hard.size(); i++)
+				f << " " << t.hard[i] << " " << t.soft[i];
+			f << "\n";
+		}
+		return f.good();
+	}
+
+	/** \brief Load transfers written by Save()
+	*
+	* \return \c TRUE if the file could be read. \c FALSE for a line with a
+	* gain of 0 or a table that is not strictly increasing in both columns or
+	* has fewer than 2 points; the transfers before it stay loaded.
+	*/
+	bool Load(const char* fileName)
+	{
+		std::ifstream f(fileName);
+		if (!f)
+			return false;
+		int s;
+		while (f >> s)
+		{
+			LithoTransfer t;
+			size_t n;
+			f >> t.linear >> t.gain >> t.offset >> t.residual >> n;
+			if (!f)
+				return false;
+			t.hard.resize(n);
+			t.soft.resize(n);
+			for (size_t i=0; i<n; i++)
+				f >> t.hard[i] >> t.soft[i];
+			if (!f || s < 0 || s >= lsCount)
+				return false;
+			if (t.linear && !(t.gain != 0))
+				return false;						// ToHard divides by it
+			if (!t.linear && n < 2)
+				return false;						// Interpolate needs two points
+			for (size_t i=1; i<n; i++)
+				if (t.hard[i] <= t.hard[i - 1] || t.soft[i] <= t.soft[i - 1])
+					return false;
+			t.valid = true;
+			cache[s] = t;
+		}
+		return true;
+	}
+
+private:
+	/** Least squares line through the points; lookup table if it does not fit and \p table allows it.
+	* Noisy reads are rejected by requiring a correlation of at least minCorrelation.
+	*/
+	bool Fit(LithoSignal sig, std::vector<double>& h, std::vector<double>& s, double minCorrelation, bool table)
+	{
+		int n = (int)h.size();
+		double mh = 0, ms = 0;
+		for (int i=0; i<n; i++)
+		{
+			mh += h[i];
+			ms += s[i];
+		}
+		mh /= n;
+		ms /= n;
+		double shh = 0, shs = 0, sss = 0;
+		double smin = s[0], smax = s[0];
+		for (int i=0; i<n; i++)
+		{
+			shh += (h[i] - mh) * (h[i] - mh);
+			shs += (h[i] - mh) * (s[i] - ms);
+			sss += (s[i] - ms) * (s[i] - ms);
+			smin = std::min(smin, s[i]);
+			smax = std::max(smax, s[i]);
+		}
+		// the points must lie on a curve, not in a noise cloud
+		if (shh <= 0 || sss <= 0 || fabs(shs) < minCorrelation * sqrt(shh * sss))
+			return false;
+
+		LithoTransfer t;
+		t.valid = true;
+		t.gain = shs / shh;
+		t.offset = ms - t.gain * mh;
+		if (!(t.gain != 0))			// ToHard divides by it
+			return false;
+		for (int i=0; i<n; i++)
+			t.residual = std::max(t.residual, fabs(t.gain * h[i] + t.offset - s[i]));
+		t.linear = !table || t.residual <= tol * (smax - smin);
+		if (!t.linear)
+		{
+			// lookup table sorted by hard value; the transfer must be monotonic
+			std::vector<std::pair<double, double> > pts(n);
+			for (int i=0; i<n; i++)
+				pts[i] = std::make_pair(h[i], s[i]);
+			std::sort(pts.begin(), pts.end());
+			for (int i=0; i<n; i++)
+			{
+				// both columns strictly increasing, or the lookups are ambiguous; decreasing transfers are not supported
+				if (i > 0 && (pts[i].first <= pts[i - 1].first || pts[i].second <= pts[i - 1].second))
+					return false;
+				t.hard.push_back(pts[i].first);
+				t.soft.push_back(pts[i].second);
+			}
+		}
+		cache[sig] = t;
+		return true;
+	}
+
+	/// Piecewise linear interpolation in a table sorted by x, extrapolated at the ends
+	static double Interpolate(const std::vector<double>& x, const std::vector<double>& y, double v)
+	{
+		size_t n = x.size();
+		size_t i = std::upper_bound(x.begin(), x.end(), v) - x.begin();
+		if (i < 1)
+			i = 1;
+		if (i > n - 1)
+			i = n - 1;
+		double dx = x[i] - x[i - 1];
+		return dx != 0 ? y[i - 1] + (y[i] - y[i - 1]) * (v - x[i - 1]) / dx : y[i];
+	}
+
+	double tol;
+	LithoTransfer cache[lsCount];
+};
+
+#endif // __NANOSCRIPT_CALIB_H__
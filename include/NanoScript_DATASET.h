@@ -0,0 +1,534 @@
+/** \file NanoScript_DATASET.h
+*	\brief Chunked N-dimensional dataset file
+*
+*	The macros write their data as flat text lines (k, ii, amplitude).
+*	To get one write voltage or one read voltage out of such a file, a
+*	viewer has to parse all of it, which stops being interactive once grid
+*	measurements reach gigabytes. LithoDataset stores an array of up to
+*	LITHO_DATASET_MAXRANK dimensions (e.g. write voltage x read voltage x
+*	position) in fixed size chunks:
+*
+*	\li The offset of every chunk follows from its index, so any chunk is
+*	read with one seek, and a slice along any axis only reads the chunks
+*	it crosses. Choose the chunk shape after the slices that are needed
+*	most: a chunk spanning a whole axis makes slices across that axis one
+*	read per chunk.
+*	\li An index after the header keeps min, max and the number of written
+*	values of every chunk, so a viewer can set its colour scale or skip
+*	empty regions without touching the data.
+*	\li Values not written yet read as NaN; a file of an interrupted
+*	measurement is valid up to the last flushed chunk.
+*	\li The file grows as chunks are written. Creating a dataset only
+*	writes the header and the index; a chunk that was never stored is
+*	marked so in the index and reads as NaN without touching the file.
+*
+*	File layout: LithoDatasetHeader, LithoChunkStats for every chunk, then
+*	the chunks as doubles, chunk by chunk in row-major chunk order, each
+*	chunk row-major inside. Edge chunks are padded to the full chunk size.
+*	The file may end, or have holes, where chunks were not stored.
+*
+*	example:
+*
+*	LithoDatasetAxis axes[2] = { LithoAxis("write_V", 17, 1, 8, -1), LithoAxis("read_V", 401, 401, 2, -0.01) };
+*	LithoDataset ds;
+*	ds.Create("Ferroelectric Char.lds", 2, axes);
+*	long long at[2] = { k_index, n };
+*	ds.Set(at, amplitude);
+*	...
+*	ds.Close();
+*
+*	std::vector<double> column;
+*	ds.ReadSlice(1, 200, column);		// all write voltages at read voltage index 200
+*/
+
+#ifndef __NANOSCRIPT_DATASET_H__
+#define __NANOSCRIPT_DATASET_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_FILE.h"
+#include "NanoScript_ARENA.h"
+#include "stdio.h"
+#include "string.h"
+#include "math.h"
+#include <limits>
+#include <vector>
+
+#define LITHO_DATASET_MAGIC		0x5344444Cu		// "LDDS"
+#define LITHO_DATASET_VERSION	1
+#define LITHO_DATASET_MAXRANK	4
+#define LITHO_DATASET_CACHE		64				// chunks kept in memory
+
+
+/// One dimension of a dataset
+struct LithoDatasetAxis
+{
+	char		name[32];
+	long long	size;				///< number of points
+	long long	chunk;				///< points per chunk along this axis
+	double		start, step;		///< coordinate of point i is start + i * step
+};
+
+
+/// Axis description for LithoDataset::Create
+inline LithoDatasetAxis LithoAxis(const char* name, long long size, long long chunk, double start = 0, double step = 1)
+{
+	LithoDatasetAxis a;
+	memset(&a, 0, sizeof(a));
+	strncpy(a.name, name, sizeof(a.name) - 1);
+	a.size = size;
+	a.chunk = chunk < 1 ? 1 : chunk > size ? size : chunk;
+	a.start = start;
+	a.step = step;
+	return a;
+}
+
+
+/// Start of the file
+struct LithoDatasetHeader
+{
+	unsigned int		magic;
+	unsigned int		version;
+	unsigned int		rank;
+	unsigned int		reserved;
+	LithoDatasetAxis	axes[LITHO_DATASET_MAXRANK];
+};
+
+
+/// Index entry of one chunk
+struct LithoChunkStats
+{
+	double		min, max;			///< of the written values; NaN if none
+	long long	count;				///< values written
+	long long	stored;				///< 1 if the chunk is in the file, 0 if it reads as NaN
+};
+
+
+/// Dataset file, see the file description
+class LithoDataset
+{
+public:
+	LithoDataset() : file(0), writable(false), chunkSize(0), chunkCount(0), cacheLimit(LITHO_DATASET_CACHE), clock(0)
+	{
+		cache.reserve(LITHO_DATASET_CACHE);
+	}
+
+	~LithoDataset() { Close(); }
+
+	/** \brief Create a new file, all values NaN
+	*
+	* Only the header and the index are written; chunks are added as they
+	* are stored.
+	*
+	* \return \c FALSE if the rank is out of range, an axis has no points or
+	* the file cannot be written.
+	*/
+	bool Create(const char* fileName, int rank, const LithoDatasetAxis* axes)
+	{
+		Close();
+		if (rank < 1 || rank > LITHO_DATASET_MAXRANK || !ValidAxes(rank, axes))
+			return false;
+		memset(&header, 0, sizeof(header));
+		header.magic = LITHO_DATASET_MAGIC;
+		header.version = LITHO_DATASET_VERSION;
+		header.rank = rank;
+		for (int i=0; i<rank; i++)
+			header.axes[i] = axes[i];
+		file = fopen(fileName, "w+b");
+		if (!file)
+			return false;
+		writable = true;
+		Layout();
+		LithoChunkStats empty = { Nan(), Nan(), 0, 0 };
+		stats.assign((size_t)chunkCount, empty);
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+			&& fwrite(&stats[0], sizeof(LithoChunkStats), (size_t)chunkCount, file) == (size_t)chunkCount;
+		if (!ok)
+			Close();
+		return ok;
+	}
+
+	/** \brief Open an existing file
+	*
+	* \param write Open for Set() as well.
+	*/
+	bool Open(const char* fileName, bool write = false)
+	{
+		Close();
+		file = fopen(fileName, write ? "r+b" : "rb");
+		if (!file)
+			return false;
+		writable = write;
+		if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != LITHO_DATASET_MAGIC
+			|| header.version != LITHO_DATASET_VERSION
+			|| header.rank < 1 || header.rank > LITHO_DATASET_MAXRANK || !ValidAxes(header.rank, header.axes))
+		{
+			Close();
+			return false;
+		}
+		Layout();
+		stats.resize((size_t)chunkCount);
+		if (fread(&stats[0], sizeof(LithoChunkStats), (size_t)chunkCount, file) != (size_t)chunkCount)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	/// Write all modified chunks and the index
+	bool Flush()
+	{
+		if (!file || !writable)
+			return file != 0;
+		bool ok = true;
+		for (size_t i=0; i<cache.size(); i++)
+			if (cache[i].index >= 0)
+				ok = Store(cache[i].index, cache[i]) && ok;
+		ok = ok && LITHO_FSEEK(file, sizeof(header), SEEK_SET) == 0
+			&& fwrite(&stats[0], sizeof(LithoChunkStats), (size_t)chunkCount, file) == (size_t)chunkCount;
+		fflush(file);
+		return ok;
+	}
+
+	void Close()
+	{
+		if (file)
+		{
+			Flush();
+			fclose(file);
+		}
+		file = 0;
+		writable = false;
+		cache.clear();
+		cacheLimit = LITHO_DATASET_CACHE;
+		stats.clear();
+	}
+
+	/** \brief Keep at most \p chunks chunks in memory, and allocate them now
+	*
+	* Call after Create or Open. A loop that writes one chunk at a time then
+	* takes no heap memory for the chunks: a chunk is stored when its slot is
+	* needed for the next one, and the slot's memory is reused.
+	*/
+	void Reserve(int chunks)
+	{
+		Flush();
+		cache.clear();
+		cacheLimit = chunks < 1 ? 1 : chunks > LITHO_DATASET_CACHE ? LITHO_DATASET_CACHE : chunks;
+		for (int i=0; i<cacheLimit; i++)
+		{
+			Chunk ch;
+			ch.index = -1;
+			ch.dirty = false;
+			ch.used = 0;
+			cache.push_back(ch);
+			cache.back().data.reserve((size_t)chunkSize);
+			LithoHeapCounter()++;
+		}
+	}
+
+	bool IsOpen() const { return file != 0; }
+
+	int Rank() const { return (int)header.rank; }
+
+	const LithoDatasetAxis& Axis(int i) const { return header.axes[i]; }
+
+	long long Chunks() const { return chunkCount; }
+
+	/// Index entry of chunk \p c, in row-major chunk order
+	const LithoChunkStats& Stats(long long c) const { return stats[(size_t)c]; }
+
+	/// Chunk holding the point at \p index
+	long long ChunkOf(const long long* index) const
+	{
+		long long c = 0;
+		for (unsigned int i=0; i<header.rank; i++)
+			c = c * chunksAlong[i] + index[i] / header.axes[i].chunk;
+		return c;
+	}
+
+	/// Set one value; \p index has one entry per axis
+	bool Set(const long long* index, double v)
+	{
+		if (!writable || !Inside(index))
+			return false;
+		long long c = ChunkOf(index);
+		Chunk* ch = Load(c);
+		if (!ch)
+			return false;
+		double& cell = ch->data[(size_t)Offset(index)];
+		LithoChunkStats& s = stats[(size_t)c];
+		if (cell != cell)
+			s.count++;
+		cell = v;
+		if (s.min != s.min || v < s.min)
+			s.min = v;
+		if (s.max != s.max || v > s.max)
+			s.max = v;
+		ch->dirty = true;
+		return true;
+	}
+
+	/// One value, NaN if not written or out of range
+	double Get(const long long* index)
+	{
+		if (!Inside(index))
+			return Nan();
+		Chunk* ch = Load(ChunkOf(index));
+		return ch ? ch->data[(size_t)Offset(index)] : Nan();
+	}
+
+	/** \brief All values with one axis held at one point
+	*
+	* \param out Receives the values of the remaining axes, row-major.
+	*
+	* Only the chunks crossing the slice are read, one seek each.
+	*/
+	bool ReadSlice(int axis, long long position, std::vector<double>& out)
+	{
+		long long lo[LITHO_DATASET_MAXRANK], hi[LITHO_DATASET_MAXRANK];
+		for (unsigned int i=0; i<header.rank; i++)
+		{
+			lo[i] = 0;
+			hi[i] = header.axes[i].size;
+		}
+		lo[axis] = position;
+		hi[axis] = position + 1;
+		return ReadBox(lo, hi, out);
+	}
+
+	/** \brief All values in the box lo <= index < hi, row-major
+	*
+	* Chunks are visited in file order and each is read once.
+	*/
+	bool ReadBox(const long long* lo, const long long* hi, std::vector<double>& out)
+	{
+		int rank = (int)header.rank;
+		long long count = 1, clo[LITHO_DATASET_MAXRANK], chi[LITHO_DATASET_MAXRANK], extent[LITHO_DATASET_MAXRANK];
+		for (int i=0; i<rank; i++)
+		{
+			if (lo[i] < 0 || hi[i] > header.axes[i].size || lo[i] >= hi[i])
+				return false;
+			extent[i] = hi[i] - lo[i];
+			count *= extent[i];
+			clo[i] = lo[i] / header.axes[i].chunk;
+			chi[i] = (hi[i] - 1) / header.axes[i].chunk;
+		}
+		out.assign((size_t)count, Nan());
+
+		long long cc[LITHO_DATASET_MAXRANK];
+		for (int i=0; i<rank; i++)
+			cc[i] = clo[i];
+		for (;;)
+		{
+			long long c = 0;
+			for (int i=0; i<rank; i++)
+				c = c * chunksAlong[i] + cc[i];
+			if (stats[(size_t)c].count > 0)
+			{
+				Chunk* ch = Load(c);
+				if (!ch)
+					return false;
+				CopyOut(*ch, cc, lo, hi, extent, out);
+			}
+			// next chunk, last axis fastest
+			int i = rank - 1;
+			while (i >= 0 && ++cc[i] > chi[i])
+			{
+				cc[i] = clo[i];
+				i--;
+			}
+			if (i < 0)
+				break;
+		}
+		return true;
+	}
+
+	/** \brief Bounds of the values in a box, from the index only
+	*
+	* The bounds are those of the chunks crossing the box, so they may be
+	* wider than the values inside it. NaN if nothing was written there.
+	*/
+	void Range(const long long* lo, const long long* hi, double& min, double& max) const
+	{
+		min = max = Nan();
+		for (long long c=0; c<chunkCount; c++)
+		{
+			long long rest = c;
+			bool inside = true;
+			for (int i=(int)header.rank-1; i>=0; i--)
+			{
+				long long k = rest % chunksAlong[i];
+				rest /= chunksAlong[i];
+				long long first = k * header.axes[i].chunk, last = first + header.axes[i].chunk;
+				inside = inside && first < hi[i] && last > lo[i];
+			}
+			const LithoChunkStats& s = stats[(size_t)c];
+			if (!inside || s.count == 0)
+				continue;
+			if (min != min || s.min < min)
+				min = s.min;
+			if (max != max || s.max > max)
+				max = s.max;
+		}
+	}
+
+private:
+	LithoDataset(const LithoDataset&);
+	LithoDataset& operator=(const LithoDataset&);
+
+	/// Slot of the chunk cache
+	struct Chunk
+	{
+		long long index;			///< chunk held, -1 if the slot is free
+		std::vector<double> data;
+		bool dirty;
+		unsigned long long used;	///< last use, for evicting the least recently used chunk
+	};
+
+	static double Nan() { return std::numeric_limits<double>::quiet_NaN(); }
+
+	/// Every axis has points, and chunks of 1 to size points along it
+	static bool ValidAxes(int rank, const LithoDatasetAxis* axes)
+	{
+		for (int i=0; i<rank; i++)
+			if (axes[i].size < 1 || axes[i].chunk < 1 || axes[i].chunk > axes[i].size)
+				return false;
+		return true;
+	}
+
+	void Layout()
+	{
+		chunkSize = 1;
+		chunkCount = 1;
+		for (unsigned int i=0; i<header.rank; i++)
+		{
+			const LithoDatasetAxis& a = header.axes[i];
+			chunksAlong[i] = (a.size + a.chunk - 1) / a.chunk;
+			chunkSize *= a.chunk;
+			chunkCount *= chunksAlong[i];
+		}
+		dataStart = sizeof(header) + chunkCount * (long long)sizeof(LithoChunkStats);
+	}
+
+	bool Inside(const long long* index) const
+	{
+		for (unsigned int i=0; i<header.rank; i++)
+			if (index[i] < 0 || index[i] >= header.axes[i].size)
+				return false;
+		return true;
+	}
+
+	/// Position of a point inside its chunk
+	long long Offset(const long long* index) const
+	{
+		long long o = 0;
+		for (unsigned int i=0; i<header.rank; i++)
+			o = o * header.axes[i].chunk + index[i] % header.axes[i].chunk;
+		return o;
+	}
+
+	Chunk* Load(long long c)
+	{
+		Chunk* slot = 0;
+		for (size_t i=0; i<cache.size(); i++)
+		{
+			Chunk& ch = cache[i];
+			if (ch.index == c)
+			{
+				ch.used = ++clock;
+				return &ch;
+			}
+			if (!slot || (slot->index >= 0 && (ch.index < 0 || ch.used < slot->used)))
+				slot = &ch;
+		}
+		if (!slot || (slot->index >= 0 && (int)cache.size() < cacheLimit))
+		{
+			Chunk ch;
+			ch.index = -1;
+			ch.dirty = false;
+			ch.used = 0;
+			cache.push_back(ch);
+			slot = &cache.back();
+		}
+		else if (slot->index >= 0)
+		{
+			if (!Store(slot->index, *slot))
+				return 0;
+			slot->index = -1;
+		}
+
+		slot->dirty = false;
+		slot->used = ++clock;
+		if (slot->data.capacity() < (size_t)chunkSize)
+			LithoHeapCounter()++;			// see LithoHeapCheck (NanoScript_ARENA.h)
+		if (!stats[(size_t)c].stored)
+			slot->data.assign((size_t)chunkSize, Nan());
+		else
+		{
+			slot->data.resize((size_t)chunkSize);
+			if (LITHO_FSEEK(file, dataStart + c * chunkSize * (long long)sizeof(double), SEEK_SET) != 0
+				|| fread(&slot->data[0], sizeof(double), (size_t)chunkSize, file) != (size_t)chunkSize)
+				return 0;
+		}
+		slot->index = c;
+		return slot;
+	}
+
+	bool Store(long long c, Chunk& ch)
+	{
+		if (!ch.dirty)
+			return true;
+		if (LITHO_FSEEK(file, dataStart + c * chunkSize * (long long)sizeof(double), SEEK_SET) != 0
+			|| fwrite(&ch.data[0], sizeof(double), (size_t)chunkSize, file) != (size_t)chunkSize)
+			return false;
+		ch.dirty = false;
+		stats[(size_t)c].stored = 1;		// in the index with the next Flush
+		return true;
+	}
+
+	/// Copy the part of chunk cc inside the box to out
+	void CopyOut(const Chunk& ch, const long long* cc, const long long* lo, const long long* hi,
+				 const long long* extent, std::vector<double>& out) const
+	{
+		int rank = (int)header.rank;
+		long long from[LITHO_DATASET_MAXRANK], to[LITHO_DATASET_MAXRANK], p[LITHO_DATASET_MAXRANK];
+		for (int i=0; i<rank; i++)
+		{
+			long long first = cc[i] * header.axes[i].chunk;
+			from[i] = first > lo[i] ? first : lo[i];
+			to[i] = first + header.axes[i].chunk < hi[i] ? first + header.axes[i].chunk : hi[i];
+			p[i] = from[i];
+		}
+		for (;;)
+		{
+			long long o = 0;
+			for (int i=0; i<rank; i++)
+				o = o * extent[i] + p[i] - lo[i];
+			out[(size_t)o] = ch.data[(size_t)Offset(p)];
+			int i = rank - 1;
+			while (i >= 0 && ++p[i] >= to[i])
+			{
+				p[i] = from[i];
+				i--;
+			}
+			if (i < 0)
+				break;
+		}
+	}
+
+	FILE* file;
+	bool writable;
+	LithoDatasetHeader header;
+	long long chunksAlong[LITHO_DATASET_MAXRANK];
+	long long chunkSize, chunkCount, dataStart;
+	std::vector<LithoChunkStats> stats;
+	std::vector<Chunk> cache;			///< reserved to LITHO_DATASET_CACHE slots, so Chunk pointers stay valid
+	int cacheLimit;
+	unsigned long long clock;
+};
+
+#endif // __NANOSCRIPT_DATASET_H__
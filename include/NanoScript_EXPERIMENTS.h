@@ -0,0 +1,142 @@
+/** \file NanoScript_EXPERIMENTS.h
+*	\brief Experiments that can be run from a queue or a request
+*
+*	Parameterized versions of the measurement macros, for LithoRunBatch
+*	(NanoScript_BATCH.h) and the resident macro server. Every experiment
+*	takes its parameters from the job, with the macro's values as defaults.
+*/
+
+#ifndef __NANOSCRIPT_EXPERIMENTS_H__
+#define __NANOSCRIPT_EXPERIMENTS_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include "NanoScript_INSTRUMENT.h"
+#include "NanoScript_STUDY.h"
+#include "NanoScript_BATCH.h"
+#include "windows.h"
+#include "fstream"
+#include <string>
+#include <vector>
+
+
+// pfm_loop: ramp with pulse mode PE loop, as Piezoreponse.cpp
+inline bool ExperimentPfmLoop(const BatchJob& job, std::string& message)
+{
+	PfmLoopParams p;
+	p.V_max = job.Get("V_max", 8);
+	p.V_step = job.Get("V_step", 0.05);
+	p.pulse_dura = job.Get("pulse_dura", 0.1);
+	p.post_pulse_time = job.Get("post_pulse_time", 0.3);
+	p.reads = (int)job.Get("reads", 3);
+	p.cycles = (int)job.Get("cycles", 1);
+	if (p.V_step <= 0 || p.reads < 2)
+	{
+		message = "V_step must be positive and reads at least 2";
+		return false;
+	}
+
+	LithoHardware hw;
+	std::vector<PfmLoopPoint> points;
+	RunPfmLoop(hw, p, points);
+
+	std::ofstream myfile(job.FileName().c_str());
+	for (size_t i=0; i<points.size(); i++)
+		myfile << points[i].volt << "\t" << points[i].pha << "\t" << points[i].amp << "\n";
+	return myfile.good();
+}
+
+// relaxor: pulse, then record lsNS5FPOutput2 against time, as Relaxor Char.cpp
+inline bool ExperimentRelaxor(const BatchJob& job, std::string& message)
+{
+	double Pulse_voltage = job.Get("Pulse_voltage", 7);
+	double Pulse_time = job.Get("Pulse_time", 1);
+	double wait = job.Get("wait", 0);
+	double Record_time = job.Get("Record_time", 60);		// seconds
+	double Interval = job.Get("Interval", 0.1);				// seconds between samples
+
+	std::ofstream myfile(job.FileName().c_str());
+	if (!LithoPulseLimited(lsBias,1000*Pulse_voltage,Pulse_time))
+	{
+		message = "pulse outside the limits";
+		return false;
+	}
+	Sleep(DWORD(1000*wait));
+	LithoStopwatch sw;
+	double next = LithoNow();
+	while (sw.Elapsed() < Record_time)
+	{
+		double Amp = LithoGetSoft(lsNS5FPOutput2);
+		myfile << sw.Elapsed() << "\t" << Amp << "\n";
+		next += Interval;
+		LithoWaitUntil(next);
+	}
+	return myfile.good();
+}
+
+// kpfm_write: hold lsNS5FPOutput1 at a voltage, as KPFM.cpp
+inline bool ExperimentKpfmWrite(const BatchJob& job, std::string& message)
+{
+	double Voltage = job.Get("Voltage", 10);				// Volts
+	double Time = job.Get("Time", 5);						// seconds
+	LithoScan(false);
+	if (!LithoSetSoftLimited(lsNS5FPOutput1,Voltage))
+	{
+		message = "voltage outside the limits";
+		return false;
+	}
+	Sleep(DWORD(1000*Time));
+	LithoSetZero(lsNS5FPOutput1);
+	return true;
+}
+
+// bias_train: repeated on/off bias, as Test.cpp
+inline bool ExperimentBiasTrain(const BatchJob& job, std::string& message)
+{
+	double Voltage = job.Get("Voltage", 1000);				// soft units of lsBias (mV)
+	double On = job.Get("On", 20);							// seconds
+	double Off = job.Get("Off", 0.5);						// seconds
+	int Count = (int)job.Get("Count", 3);
+	for (int ii=0; ii<Count; ii++)
+	{
+		if (!LithoSetSoftLimited(lsBias,Voltage))
+		{
+			message = "voltage outside the limits";
+			return false;
+		}
+		Sleep(DWORD(1000*On));
+		LithoSetZero(lsBias,false);
+		Sleep(DWORD(1000*Off));
+	}
+	return true;
+}
+
+// wait: let the system settle, e.g. after a large move
+inline bool ExperimentWait(const BatchJob& job, std::string&)
+{
+	Sleep(DWORD(1000*job.Get("Secs", 10)));
+	return true;
+}
+
+/** \brief The experiments above, by name, for LithoRunBatch and LithoRunJob
+*
+* \param count Receives the number of entries.
+*/
+inline const BatchExperimentEntry* LithoExperiments(int& count)
+{
+	static const BatchExperimentEntry experiments[] =
+	{
+		{ "pfm_loop",	ExperimentPfmLoop },
+		{ "relaxor",	ExperimentRelaxor },
+		{ "kpfm_write",	ExperimentKpfmWrite },
+		{ "bias_train",	ExperimentBiasTrain },
+		{ "wait",		ExperimentWait }
+	};
+	count = sizeof(experiments) / sizeof(experiments[0]);
+	return experiments;
+}
+
+#endif // __NANOSCRIPT_EXPERIMENTS_H__
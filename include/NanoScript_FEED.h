@@ -0,0 +1,280 @@
+/** \file NanoScript_FEED.h
+*	\brief Live data feed through a shared memory ring
+*
+*	Rewriting a text file for every point is a slow way to show progress:
+*	the macro pays for the file I/O and viewers see partial files.
+*	LithoFeedWriter publishes samples into a named shared memory ring
+*	instead. Any number of viewers (LithoFeedReader, tools/FeedTail.cpp)
+*	can map the ring and follow it without slowing the macro down: the
+*	writer never waits for readers, and a reader that falls behind by more
+*	than the ring size skips the lost records and is told how many.
+*
+*	Protocol: the header holds the sequence number of the next record to be
+*	written. Each record holds its own sequence stamp, 2*seq+1 while it is
+*	being written and 2*seq+2 once complete. A reader copies a record and
+*	accepts the copy only if the stamp was 2*seq+2 both before and after
+*	copying.
+*
+*	example:
+*
+*	LithoFeedWriter feed("Piezoresponse", "volt\tphase\tamp");
+*	...
+*	double v[3] = { Volt_now, pha, amp };
+*	feed.Publish(v, 3);
+*/
+
+#ifndef __NANOSCRIPT_FEED_H__
+#define __NANOSCRIPT_FEED_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "windows.h"
+#include "NanoScript_TIMING.h"
+#include <string.h>
+
+#define LITHO_FEED_MAGIC		0x4644454Eu		// "NEDF"
+#define LITHO_FEED_CHANNELS		8				// values per record
+#define LITHO_FEED_RECORDS		65536			// ring size, power of two
+
+
+/// Layout of the start of the shared memory
+struct LithoFeedHeader
+{
+	unsigned int		magic;
+	unsigned int		records;				///< ring size, power of two
+	unsigned int		channels;				///< values used per record
+	unsigned int		reserved;
+	volatile LONG64		head;					///< sequence number of the next record to write
+	char				names[256];				///< tab separated channel names
+};
+
+
+/// One record of the ring
+struct LithoFeedRecord
+{
+	volatile LONG64		stamp;					///< 2*seq+1 while written, 2*seq+2 when complete
+	double				time;					///< seconds since the writer was created
+	double				values[LITHO_FEED_CHANNELS];
+};
+
+
+/// Name of the shared memory object of a feed
+inline void LithoFeedObjectName(const char* feed, char* name, size_t size)
+{
+	_snprintf(name, size, "Local\\NanoScriptFeed_%s", feed);
+	name[size - 1] = 0;
+}
+
+
+/** \brief Publishes samples into a named feed
+*
+* Creating the writer creates (or reopens) the shared memory; it stays alive
+* as long as the writer or any reader has it mapped.
+*/
+class LithoFeedWriter
+{
+public:
+	/** \param feed Name of the feed, viewers open it by this name.
+	* \param names Tab separated channel names, shown by viewers.
+	*/
+	LithoFeedWriter(const char* feed, const char* names) : mapping(0), header(0), records(0), origin(LithoNow())
+	{
+		char name[128];
+		LithoFeedObjectName(feed, name, sizeof(name));
+		DWORD size = sizeof(LithoFeedHeader) + LITHO_FEED_RECORDS * sizeof(LithoFeedRecord);
+		mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE, 0, size, name);
+		if (!mapping)
+			return;
+		header = (LithoFeedHeader*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+		if (!header)
+			return;
+		records = (LithoFeedRecord*)(header + 1);
+		// a new run starts a new sequence; readers notice the head going backwards
+		header->magic = 0;
+		MemoryBarrier();
+		header->records = LITHO_FEED_RECORDS;
+		header->channels = 0;
+		strncpy(header->names, names ? names : "", sizeof(header->names) - 1);
+		header->names[sizeof(header->names) - 1] = 0;
+		for (int i=0; i<LITHO_FEED_RECORDS; i++)
+			records[i].stamp = 0;
+		InterlockedExchange64(&header->head, 0);
+		MemoryBarrier();
+		header->magic = LITHO_FEED_MAGIC;
+	}
+
+	~LithoFeedWriter()
+	{
+		if (header)
+			UnmapViewOfFile(header);
+		if (mapping)
+			CloseHandle(mapping);
+	}
+
+	/// \c TRUE if the shared memory could be created
+	bool IsOpen() const { return header != 0; }
+
+	/** \brief Publish one record
+	*
+	* \param values Values of the record, at most LITHO_FEED_CHANNELS.
+	* \param n Number of values.
+	*
+	* \return The sequence number of the record, or -1 if the feed is not open.
+	*/
+	LONG64 Publish(const double* values, int n)
+	{
+		if (!header)
+			return -1;
+		if (n > LITHO_FEED_CHANNELS)
+			n = LITHO_FEED_CHANNELS;
+		if ((unsigned int)n > header->channels)
+			header->channels = n;
+		LONG64 seq = header->head;
+		LithoFeedRecord& r = records[seq & (LITHO_FEED_RECORDS - 1)];
+		r.stamp = 2 * seq + 1;
+		MemoryBarrier();
+		r.time = LithoNow() - origin;
+		for (int i=0; i<n; i++)
+			r.values[i] = values[i];
+		for (int i=n; i<LITHO_FEED_CHANNELS; i++)
+			r.values[i] = 0;
+		MemoryBarrier();
+		r.stamp = 2 * seq + 2;
+		InterlockedExchange64(&header->head, seq + 1);
+		return seq;
+	}
+
+private:
+	LithoFeedWriter(const LithoFeedWriter&);
+	LithoFeedWriter& operator=(const LithoFeedWriter&);
+
+	HANDLE mapping;
+	LithoFeedHeader* header;
+	LithoFeedRecord* records;
+	double origin;
+};
+
+
+/** \brief Follows a feed from another process
+*
+* example:
+*
+* LithoFeedReader feed;
+* while (!feed.Open("Piezoresponse")) Sleep(500);
+* LithoFeedRecord r;
+* for (;;)
+*	if (feed.Next(r)) print(r); else Sleep(10);
+*/
+class LithoFeedReader
+{
+public:
+	LithoFeedReader() : mapping(0), header(0), records(0), next(0), lost(0) {}
+
+	~LithoFeedReader() { Close(); }
+
+	/** \brief Map an existing feed
+	*
+	* \param fromStart Start with the oldest record still in the ring
+	* (\c TRUE) or with the next record written (\c FALSE).
+	*
+	* \return \c TRUE if the feed exists.
+	*/
+	bool Open(const char* feed, bool fromStart = true)
+	{
+		Close();
+		char name[128];
+		LithoFeedObjectName(feed, name, sizeof(name));
+		mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+		if (!mapping)
+			return false;
+		header = (const LithoFeedHeader*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!header)
+		{
+			Close();
+			return false;
+		}
+		records = (const LithoFeedRecord*)(header + 1);
+		LONG64 head = header->head;
+		next = fromStart && head > LITHO_FEED_RECORDS ? head - LITHO_FEED_RECORDS : fromStart ? 0 : head;
+		return true;
+	}
+
+	void Close()
+	{
+		if (header)
+			UnmapViewOfFile((void*)header);
+		if (mapping)
+			CloseHandle(mapping);
+		header = 0;
+		records = 0;
+		mapping = 0;
+	}
+
+	/// Channel names as given by the writer
+	const char* Names() const { return header ? header->names : ""; }
+
+	/// Number of values used per record
+	int Channels() const { return header ? (int)header->channels : 0; }
+
+	/// Records overwritten before this reader got to them
+	LONG64 Lost() const { return lost; }
+
+	/** \brief Copy the next record, if there is one
+	*
+	* \param out Receives the record; its \c stamp is set to the sequence
+	* number of the record.
+	*
+	* \return \c TRUE if a record was copied, \c FALSE if the reader has
+	* caught up with the writer.
+	*/
+	bool Next(LithoFeedRecord& out)
+	{
+		if (!header || header->magic != LITHO_FEED_MAGIC)
+			return false;
+		for (;;)
+		{
+			LONG64 head = header->head;
+			if (head < next)
+				next = 0;								// the writer was restarted
+			if (next >= head)
+				return false;
+			if (head - next > LITHO_FEED_RECORDS)
+			{
+				lost += head - LITHO_FEED_RECORDS - next;
+				next = head - LITHO_FEED_RECORDS;
+			}
+			const LithoFeedRecord& r = records[next & (LITHO_FEED_RECORDS - 1)];
+			LONG64 want = 2 * next + 2;
+			LONG64 before = r.stamp;
+			MemoryBarrier();
+			out.time = r.time;
+			for (int i=0; i<LITHO_FEED_CHANNELS; i++)
+				out.values[i] = r.values[i];
+			MemoryBarrier();
+			LONG64 after = r.stamp;
+			if (before == want && after == want)
+			{
+				out.stamp = next++;
+				return true;
+			}
+			if (before < want)
+				return false;							// still being written
+			lost++;										// overwritten while copying
+			next++;
+		}
+	}
+
+private:
+	LithoFeedReader(const LithoFeedReader&);
+	LithoFeedReader& operator=(const LithoFeedReader&);
+
+	HANDLE mapping;
+	const LithoFeedHeader* header;
+	const LithoFeedRecord* records;
+	LONG64 next;
+	LONG64 lost;
+};
+
+#endif // __NANOSCRIPT_FEED_H__
@@ -0,0 +1,26 @@
+/** \file NanoScript_FILE.h
+*	\brief 64-bit file positions for the data file formats
+*
+*	fseek and ftell take a long, which is 32 bits on Windows, so files past
+*	2 GB need the 64-bit variants. LITHO_FSEEK and LITHO_FTELL pick the one
+*	of the compiler; used by NanoScript_DATASET.h and NanoScript_PYRAMID.h.
+*/
+
+#ifndef __NANOSCRIPT_FILE_H__
+#define __NANOSCRIPT_FILE_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "stdio.h"
+
+#ifdef _MSC_VER
+#define LITHO_FSEEK		_fseeki64
+#define LITHO_FTELL		_ftelli64
+#else
+#define LITHO_FSEEK		fseeko
+#define LITHO_FTELL		ftello
+#endif
+
+#endif // __NANOSCRIPT_FILE_H__
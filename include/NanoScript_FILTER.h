@@ -0,0 +1,214 @@
+/** \file NanoScript_FILTER.h
+*	\brief Streaming robust filters for glitchy lock-in outputs
+*
+*	The NS5 front panel outputs occasionally read as exactly 0. The macros
+*	catch this with checkzero loops that read again (or even pulse again),
+*	which costs time and still lets through glitches that are not exactly
+*	zero. The filters here work inline on the stream of reads instead:
+*
+*	\li LithoRunningMedian - median of the last n samples, O(log n) per sample.
+*	\li LithoHampelFilter - replaces a sample by the running median when it
+*	is further than a threshold times the robust scale (MAD) from it, and
+*	passes it through otherwise.
+*
+*	example:
+*
+*	LithoHampelFilter hampel(9, 3);
+*	for (...)
+*	{
+*		double amp = hampel.Filter(LithoGetSoft(lsNS5FPOutput2));
+*		myfile << amp << "\t" << hampel.LastRejected() << "\n";
+*	}
+*
+*	Unlike the checkzero loops, a genuine value of 0 (e.g. a nulled KPFM
+*	signal) is not rejected as long as its neighbours are close to 0 too.
+*/
+
+#ifndef __NANOSCRIPT_FILTER_H__
+#define __NANOSCRIPT_FILTER_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "math.h"
+#include <iterator>
+#include <set>
+#include <vector>
+
+
+/** \brief Median of the last \c window samples
+*
+* The window is kept in two sorted halves (std::multiset), the lower half
+* never smaller than the upper one; adding and dropping a sample are
+* O(log window).
+*/
+class LithoRunningMedian
+{
+public:
+	explicit LithoRunningMedian(int window = 9) : size(window < 1 ? 1 : window), next(0), count(0)
+	{
+		ring.resize(size);
+	}
+
+	/** \brief Add a sample, dropping the oldest one if the window is full
+	*
+	* A NaN sample has no place in the sorted halves and is ignored.
+	*
+	* \return The new median.
+	*/
+	double Add(double x)
+	{
+		if (x != x)
+			return Median();
+		if (count == size)
+			Remove(ring[next]);
+		else
+			count++;
+		ring[next] = x;
+		next = (next + 1) % size;
+
+		if (lower.empty() || x <= *lower.rbegin())
+			lower.insert(x);
+		else
+			upper.insert(x);
+		Balance();
+		return Median();
+	}
+
+	/// Median of the samples in the window, 0 if there are none
+	double Median() const
+	{
+		if (lower.empty())
+			return 0;
+		if (lower.size() > upper.size())
+			return *lower.rbegin();
+		return 0.5 * (*lower.rbegin() + *upper.begin());
+	}
+
+	int		Count() const	{ return count; }
+	int		Window() const	{ return size; }
+	bool	Full() const	{ return count == size; }
+
+	void Clear()
+	{
+		lower.clear();
+		upper.clear();
+		next = 0;
+		count = 0;
+	}
+
+private:
+	void Remove(double x)
+	{
+		std::multiset<double>::iterator it = lower.find(x);
+		if (it != lower.end())
+			lower.erase(it);
+		else
+			upper.erase(upper.find(x));
+		Balance();
+	}
+
+	/// lower holds ceil(n/2) samples, upper floor(n/2)
+	void Balance()
+	{
+		while (lower.size() > upper.size() + 1)
+		{
+			std::multiset<double>::iterator it = std::prev(lower.end());
+			upper.insert(*it);
+			lower.erase(it);
+		}
+		while (upper.size() > lower.size())
+		{
+			lower.insert(*upper.begin());
+			upper.erase(upper.begin());
+		}
+	}
+
+	int size;
+	std::vector<double> ring;
+	int next, count;
+	std::multiset<double> lower, upper;
+};
+
+
+/** \brief Causal Hampel filter over a sliding window
+*
+* Each sample is compared with the median of the window before it. The
+* robust scale is 1.4826 times the running median of the absolute
+* deviations of the samples from the median at the time they came in; this
+* keeps the cost at O(log window) per sample and follows the exact MAD
+* closely while the signal changes slowly compared to the window.
+*
+* All samples enter the window, rejected ones too, so the window stays
+* aligned in time and a real step in the signal is accepted after about
+* half a window. A NaN sample is the exception: it is rejected and
+* replaced by the median, but does not enter the window.
+*/
+class LithoHampelFilter
+{
+public:
+	/** \param window Samples in the window.
+	* \param threshold Rejection threshold in units of the robust scale; 3 is usual.
+	* \param minScale Lower bound of the scale, so that a very clean or
+	* quantized signal does not reject its own noise.
+	*/
+	explicit LithoHampelFilter(int window = 9, double threshold = 3, double minScale = 0) :
+		median(window), deviation(window), k(threshold), minimum(minScale), rejected(0), last(false)
+	{}
+
+	/// Filter one sample. \return The sample, or the running median if it is an outlier.
+	double Filter(double x)
+	{
+		last = false;
+		double out = x;
+		double m = median.Median();
+		if (x != x)
+		{
+			last = true;
+			rejected++;
+			return m;
+		}
+		if (deviation.Count() >= 3)
+		{
+			double scale = 1.4826 * deviation.Median();
+			if (scale < minimum)
+				scale = minimum;
+			if (fabs(x - m) > k * scale)
+			{
+				last = true;
+				rejected++;
+				out = m;
+			}
+		}
+		if (median.Count() > 0)
+			deviation.Add(fabs(x - m));
+		median.Add(x);
+		return out;
+	}
+
+	/// \c TRUE if the last sample was replaced
+	bool	LastRejected() const	{ return last; }
+
+	/// Samples replaced since construction or Clear()
+	long	Rejected() const		{ return rejected; }
+
+	/// Running median of the window
+	double	Median() const			{ return median.Median(); }
+
+	void Clear()
+	{
+		median.Clear();
+		deviation.Clear();
+		rejected = 0;
+		last = false;
+	}
+
+private:
+	LithoRunningMedian median, deviation;
+	double k, minimum;
+	long rejected;
+	bool last;
+};
+
+#endif // __NANOSCRIPT_FILTER_H__
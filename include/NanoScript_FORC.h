@@ -0,0 +1,283 @@
+/** \file NanoScript_FORC.h
+*	\brief First order reversal curves (FORC) of the piezoresponse
+*
+*	A single hysteresis loop only shows the outer branches; how the
+*	switching fields are distributed, and how they interact, shows in the
+*	first order reversal curves. Each curve starts from positive
+*	saturation, reverses at a field Vr and is measured on the way back up,
+*	at fields V >= Vr. The FORC distribution is the mixed derivative
+*	rho(Vr, V) = -1/2 d2M / dVr dV.
+*
+*	ForcBuildSchedule turns a list of reversal fields into a sequence of
+*	pulses. All fields lie on one grid of ForcParams::step. The schedule
+*	saves transitions and dwell time over the textbook sequence:
+*
+*	\li Every curve ends at the saturation field, so it saturates the
+*	sample for the next curve; only the first curve gets its own
+*	saturation pulse.
+*	\li The way down to Vr is a single pulse at Vr: pulses between
+*	saturation and Vr would be wiped out by the pulse at Vr anyway.
+*	\li Only measured fields wait for the lock-in before reading.
+*
+*	RunForc runs a schedule on any instrument (NanoScript_INSTRUMENT.h) and
+*	stores the in-phase response X (NanoScript_PHASE.h) in a 2-D
+*	LithoDataset over (Vr, V) on the field grid, one chunk per curve;
+*	fields below Vr stay NaN. ForcDistribution computes rho from such a
+*	dataset, spread over all cores (tools/ForcDistribution.cpp).
+*
+*	example:
+*
+*	ForcParams p;									// +-8 V in 0.1 V steps
+*	std::vector<double> vr;
+*	for (double v=7.9; v>=-8; v-=0.2) vr.push_back(v);
+*	ForcSchedule plan;
+*	ForcBuildSchedule(p, vr, plan);
+*	LithoDataset data;
+*	ForcCreateDataset(data, "FORC.lds", p);
+*	LithoHardware afm;
+*	RunForc(afm, p, plan, data);
+*/
+
+#ifndef __NANOSCRIPT_FORC_H__
+#define __NANOSCRIPT_FORC_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include "NanoScript_DATASET.h"
+#include "NanoScript_PHASE.h"
+#include "NanoScript_SIGNALS.h"
+#include "NanoScript_STUDY.h"
+#include "math.h"
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+
+/// Parameters of a FORC measurement
+struct ForcParams
+{
+	double	vSat;				///< saturation field, also the top of every curve (V)
+	double	step;				///< field step along the curves and grid of the reversal fields (V)
+	double	pulse;				///< pulse width (s)
+	double	wait;				///< wait between a measured pulse and the reads (s)
+	double	targetSem;			///< read until the standard error of the response is below this (mV) ...
+	double	targetPhaseSem;		///< ... and that of its phase below this (degrees)
+	int		minReads, maxReads;	///< read pairs per field
+
+	ForcParams() : vSat(8), step(0.1), pulse(0.1), wait(0.3), targetSem(0.2), targetPhaseSem(0.5), minReads(3), maxReads(30) {}
+};
+
+
+/// Number of fields on the grid, from -vSat to vSat
+inline int ForcGridSize(const ForcParams& p)
+{
+	return 2 * (int)floor(p.vSat / p.step + 0.5) + 1;
+}
+
+/// Field of grid index j
+inline double ForcGridVolt(const ForcParams& p, int j)
+{
+	return (j - (ForcGridSize(p) - 1) / 2) * p.step;
+}
+
+/// Grid index nearest to a field
+inline int ForcGridIndex(const ForcParams& p, double volt)
+{
+	int j = (int)floor(volt / p.step + 0.5) + (ForcGridSize(p) - 1) / 2;
+	return j < 0 ? 0 : j >= ForcGridSize(p) ? ForcGridSize(p) - 1 : j;
+}
+
+
+/// One pulse of a schedule
+struct ForcStep
+{
+	int		reversal;		///< grid index of the Vr of the curve, -1 for the first saturation
+	int		field;			///< grid index of the pulse field
+	bool	measure;		///< read the response after this pulse
+};
+
+
+/// Pulse sequence of a FORC measurement
+struct ForcSchedule
+{
+	std::vector<ForcStep>	steps;
+	int		curves;
+	int		pulses;			///< pulses of this schedule
+	int		naivePulses;	///< pulses of the textbook sequence: saturate, step down to Vr, step up
+	double	dwellSecs;		///< pulse and wait time of this schedule (reads not included)
+	double	naiveDwellSecs;	///< the same for the textbook sequence, waiting after every pulse
+};
+
+
+/** \brief Build the pulse sequence for a list of reversal fields
+*
+* Reversal fields are rounded to the grid; duplicates and fields at or
+* above saturation are dropped. Curves are run from the highest Vr down,
+* so the first curves are the short ones and the data fills in from the
+* saturated corner.
+*/
+inline void ForcBuildSchedule(const ForcParams& p, const std::vector<double>& reversals, ForcSchedule& s)
+{
+	int top = ForcGridSize(p) - 1;
+	std::vector<int> rev;
+	for (size_t i=0; i<reversals.size(); i++)
+	{
+		int j = ForcGridIndex(p, reversals[i]);
+		if (j < top)
+			rev.push_back(j);
+	}
+	std::sort(rev.begin(), rev.end(), std::greater<int>());
+	rev.erase(std::unique(rev.begin(), rev.end()), rev.end());
+
+	s.steps.clear();
+	s.curves = (int)rev.size();
+	s.naivePulses = 0;
+	int waits = 0, naiveWaits = 0;
+	ForcStep sat = { -1, top, false };
+	s.steps.push_back(sat);
+	for (size_t c=0; c<rev.size(); c++)
+	{
+		int r = rev[c];
+		for (int j=r; j<=top; j++)
+		{
+			ForcStep st = { r, j, true };
+			s.steps.push_back(st);
+			waits++;
+		}
+		// textbook: saturate, step down to Vr, step up measuring
+		s.naivePulses += 1 + (top - r) + (top - r + 1);
+		naiveWaits += 1 + (top - r) + (top - r + 1);
+	}
+	s.pulses = (int)s.steps.size();
+	s.dwellSecs = s.pulses * p.pulse + waits * p.wait;
+	s.naiveDwellSecs = s.naivePulses * p.pulse + naiveWaits * p.wait;
+}
+
+
+/// Create the dataset RunForc writes: Vr x V on the field grid, one chunk per curve
+inline bool ForcCreateDataset(LithoDataset& data, const char* fileName, const ForcParams& p)
+{
+	int n = ForcGridSize(p);
+	LithoDatasetAxis axes[2] = { LithoAxis("Vr", n, 1, ForcGridVolt(p, 0), p.step),
+								 LithoAxis("V", n, n, ForcGridVolt(p, 0), p.step) };
+	return data.Create(fileName, 2, axes);
+}
+
+
+/** \brief Run a schedule, storing the in-phase response in mV
+*
+* Pulses lsBias; reads the PFM amplitude and phase through their channels
+* (PfmAmplitude, PfmPhase in NanoScript_SIGNALS.h) as Piezoreponse.cpp,
+* averaged as a vector. The dataset is flushed after every curve.
+*
+* \return \c FALSE if a pulse was refused (e.g. by the session limits).
+*/
+template <class Instrument>
+bool RunForc(Instrument& inst, const ForcParams& p, const ForcSchedule& s, LithoDataset& data)
+{
+	for (size_t i=0; i<s.steps.size(); i++)
+	{
+		const ForcStep& st = s.steps[i];
+		if (!inst.Pulse(lsBias, 1000 * ForcGridVolt(p, st.field), p.pulse))
+			return false;
+		if (!st.measure)
+			continue;
+		inst.Pause(p.wait);
+		LithoVectorAverage v = LithoVectorAverageUntil(
+			[&]{ return LithoReadChannel<PfmAmplitude>(inst).value; },
+			[&]{ return LithoReadChannel<PfmPhase>(inst).value; },
+			p.targetSem, p.targetPhaseSem, p.minReads, p.maxReads, p.minReads);
+		long long at[2] = { st.reversal, st.field };
+		data.Set(at, v.x);
+		if (i + 1 == s.steps.size() || s.steps[i + 1].reversal != st.reversal)
+			data.Flush();
+	}
+	return true;
+}
+
+
+/** \brief FORC distribution of one grid point from a local quadratic fit
+*
+* Fits M = a0 + a1 x + a2 x^2 + a3 y + a4 y^2 + a5 x y (x = Vr, y = V
+* relative to the point, in V) to the measured values within +-sf grid
+* points and returns rho = -a5 / 2, or NaN if fewer than 7 values were found.
+*
+* \param m Values in row-major order, m[r * n + j] for reversal r and field j; NaN where not measured.
+*/
+inline double ForcDistributionAt(const double* m, int n, double step, int r, int j, int sf)
+{
+	double ata[6][7];
+	for (int a=0; a<6; a++)
+		for (int b=0; b<7; b++)
+			ata[a][b] = 0;
+	int count = 0;
+	for (int rr=r-sf; rr<=r+sf; rr++)
+	{
+		if (rr < 0 || rr >= n)
+			continue;
+		for (int jj=j-sf; jj<=j+sf; jj++)
+		{
+			if (jj < 0 || jj >= n)
+				continue;
+			double z = m[(size_t)rr * n + jj];
+			if (z != z)
+				continue;				// NaN
+			double x = (rr - r) * step, y = (jj - j) * step;
+			double f[6] = { 1, x, x * x, y, y * y, x * y };
+			for (int a=0; a<6; a++)
+			{
+				for (int b=0; b<6; b++)
+					ata[a][b] += f[a] * f[b];
+				ata[a][6] += f[a] * z;
+			}
+			count++;
+		}
+	}
+	if (count < 7)
+		return NAN;
+
+	// normal equations, Gauss-Jordan with partial pivoting
+	for (int c=0; c<6; c++)
+	{
+		int pivot = c;
+		for (int a=c+1; a<6; a++)
+			if (fabs(ata[a][c]) > fabs(ata[pivot][c]))
+				pivot = a;
+		if (fabs(ata[pivot][c]) < 1e-12)
+			return NAN;
+		for (int b=0; b<7; b++)
+			std::swap(ata[c][b], ata[pivot][b]);
+		for (int a=0; a<6; a++)
+		{
+			if (a == c)
+				continue;
+			double k = ata[a][c] / ata[c][c];
+			for (int b=c; b<7; b++)
+				ata[a][b] -= k * ata[c][b];
+		}
+	}
+	return -0.5 * ata[5][6] / ata[5][5];
+}
+
+
+/** \brief FORC distribution of a whole measurement
+*
+* \param m Values as written by RunForc, row-major n x n, see ForcDistributionAt.
+* \param sf Smoothing factor: the fit uses (2 sf + 1)^2 grid points at most.
+* \param rho Receives n x n values, NaN where there is too little data.
+* \param threads Worker threads, 0 for one per core; rows are independent.
+*/
+inline void ForcDistribution(const std::vector<double>& m, int n, double step, int sf, std::vector<double>& rho,
+							 int threads = 0)
+{
+	rho.assign((size_t)n * n, NAN);
+	ParallelFor(n, threads, [&](int r) {
+		for (int j=r; j<n; j++)
+			rho[(size_t)r * n + j] = ForcDistributionAt(&m[0], n, step, r, j, sf);
+	});
+}
+
+#endif // __NANOSCRIPT_FORC_H__
@@ -0,0 +1,44 @@
+/** \file NanoScript_INSTRUMENT.h
+*	\brief Instrument adapter for measurement plans
+*
+*	Measurement plans that should run both on the microscope and on the
+*	simulated instrument (NanoScript_SIM.h) are written as templates over an
+*	instrument type. LithoHardware forwards to the Litho functions;
+*	SimInstrument provides the same members on a model.
+*
+*	Members every instrument provides:
+*
+*	\li bool Set(LithoSignal, double) / SetSoft(LithoSignal, double)
+*	\li double Get(LithoSignal) / GetSoft(LithoSignal)
+*	\li bool Pulse(LithoSignal, double v, double secs)
+*	\li void Pause(double secs)
+*	\li bool Translate(double dxUm, double dyUm, double rateUmPerSec)
+*	\li double Now()
+*/
+
+#ifndef __NANOSCRIPT_INSTRUMENT_H__
+#define __NANOSCRIPT_INSTRUMENT_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include "NanoScript_TIMING.h"
+#include "NanoScript_LIMITS.h"
+
+
+/// The microscope, through the Litho functions; outputs within the session limits (NanoScript_LIMITS.h)
+struct LithoHardware
+{
+	bool	Set(LithoSignal output, double v)				{ return LithoSetLimited(output, v); }
+	bool	SetSoft(LithoSignal output, double v)			{ return LithoSetSoftLimited(output, v); }
+	double	Get(LithoSignal input)							{ return LithoGet(input); }
+	double	GetSoft(LithoSignal input)						{ return LithoGetSoft(input); }
+	bool	Pulse(LithoSignal output, double v, double secs)	{ return LithoPulseLimited(output, v, secs); }
+	void	Pause(double secs)								{ LithoWaitUntil(LithoNow() + secs); }
+	bool	Translate(double dxUm, double dyUm, double rateUmPerSec)	{ return LithoTranslate(dxUm, dyUm, rateUmPerSec); }
+	double	Now()											{ return LithoNow(); }
+};
+
+#endif // __NANOSCRIPT_INSTRUMENT_H__
@@ -0,0 +1,305 @@
+/** \file NanoScript_KPFM.h
+*	\brief Software KPFM: null the electrostatic signal with a PI(D) loop
+*
+*	The KPFM macros find the surface potential by stepping the tip bias over
+*	a range and reading the electrostatic response at every step, one full
+*	sweep per value. The response is proportional to the bias minus the
+*	contact potential, so a feedback loop that drives the response to zero
+*	finds the potential directly: the bias at which the loop settles is the
+*	potential.
+*
+*	KpfmNull runs that loop in software on any instrument
+*	(NanoScript_INSTRUMENT.h): read the response, correct the drive, wait
+*	one interval. The loop is considered settled when the response stays
+*	within the tolerance for a number of consecutive reads; the potential is
+*	the mean drive over those reads.
+*
+*	example:
+*
+*	LithoHardware afm;
+*	KpfmNullParams p;							// drives lsNS5FPOutput1, reads lsNS5FPOutput2
+*	KpfmNullResult r = KpfmNull(afm, p);
+*	if (r.nulled)
+*		myfile << 1000 * r.potential << "\n";	// mV
+*
+*	The drive is left at the nulling value when the function returns.
+*
+*	Where a feedback loop is not wanted (e.g. the response is too slow for
+*	it), KpfmFindZero finds the same zero crossing with a bracketed root
+*	search (Brent's method) over a few averaged reads, instead of reading
+*	every point of a sweep.
+*/
+
+#ifndef __NANOSCRIPT_KPFM_H__
+#define __NANOSCRIPT_KPFM_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include "math.h"
+#include <algorithm>
+
+
+/// Settings of the nulling loop
+struct KpfmNullParams
+{
+	LithoSignal	drive;				///< output driven by the loop
+	double		driveScale;			///< drive units per volt: 1 for lsNS5FPOutput1, 1000 for lsBias (mV)
+	LithoSignal	error;				///< input carrying the electrostatic response
+	double		polarity;			///< +1 if the response grows with the drive, -1 otherwise
+	double		kp;					///< proportional gain (V per unit of response)
+	double		ki;					///< integral gain (V per unit of response and second)
+	double		kd;					///< derivative gain (V s per unit of response)
+	double		interval;			///< loop period (s)
+	double		start;				///< initial drive (V)
+	double		limit;				///< the drive is kept within +-limit (V)
+	double		tolerance;			///< response considered nulled (units of the response)
+	int			settleCount;		///< consecutive reads within the tolerance to stop
+	double		maxSecs;			///< give up after this long
+
+	KpfmNullParams() :
+		drive(lsNS5FPOutput1), driveScale(1), error(lsNS5FPOutput2), polarity(1),
+		kp(2), ki(250), kd(0), interval(0.002), start(0), limit(2),
+		tolerance(0.002), settleCount(10), maxSecs(1)
+	{}
+};
+
+
+/// Outcome of KpfmNull
+struct KpfmNullResult
+{
+	bool	nulled;					///< \c TRUE if the loop settled before maxSecs
+	double	potential;				///< mean drive over the settled reads, or the last drive (V)
+	double	error;					///< last response read
+	double	secs;					///< time taken
+	int		iterations;				///< loop iterations
+	int		glitches;				///< reads of exactly 0 that were skipped
+};
+
+
+/** \brief Null the electrostatic response, see the file description
+*
+* Reads of exactly 0 are glitches of the NS5 outputs and are skipped, like
+* the checkzero blocks of the KPFM macros. The integrator stops while the
+* drive is at its limit, so the loop recovers quickly if the potential is
+* out of range for a while.
+*/
+template <class Instrument>
+KpfmNullResult KpfmNull(Instrument& inst, const KpfmNullParams& p)
+{
+	KpfmNullResult r;
+	r.nulled = false;
+	r.error = 0;
+	r.iterations = 0;
+	r.glitches = 0;
+
+	double v = p.start;
+	double integral = p.start;			// the integrator holds the drive, P and D act around it
+	double previous = 0, last = inst.Now();
+	double start = last, sum = 0;
+	int inside = 0;
+	inst.SetSoft(p.drive, p.driveScale * v);
+
+	while (inst.Now() - start < p.maxSecs)
+	{
+		inst.Pause(p.interval);
+		double e = inst.GetSoft(p.error);
+		double now = inst.Now();
+		double dt = now - last;
+		last = now;
+		r.iterations++;
+		if (e == 0)
+		{
+			r.glitches++;
+			continue;
+		}
+		r.error = e;
+
+		// settled: average the drive over the reads within the tolerance
+		if (fabs(e) <= p.tolerance)
+		{
+			inside++;
+			sum += v;
+			if (inside >= p.settleCount)
+			{
+				r.nulled = true;
+				break;
+			}
+		}
+		else
+		{
+			inside = 0;
+			sum = 0;
+		}
+
+		e *= p.polarity;
+		double derivative = r.iterations > 1 && dt > 0 ? (e - previous) / dt : 0;
+		previous = e;
+		double candidate = integral - p.ki * e * dt;
+		if (fabs(candidate) <= p.limit)
+			integral = candidate;
+		v = integral - p.kp * e - p.kd * derivative;
+		if (v > p.limit)
+			v = p.limit;
+		if (v < -p.limit)
+			v = -p.limit;
+		inst.SetSoft(p.drive, p.driveScale * v);
+	}
+	r.potential = inside > 0 ? sum / inside : v;
+	r.secs = inst.Now() - start;
+	return r;
+}
+
+
+/// Settings of the zero crossing search
+struct KpfmSearchParams
+{
+	LithoSignal	drive;				///< output that is stepped
+	double		driveScale;			///< drive units per volt: 1 for lsNS5FPOutput1, 1000 for lsBias (mV)
+	LithoSignal	error;				///< input carrying the electrostatic response
+	double		lo, hi;				///< bracket of the search (V); the response must change sign in it
+	int			reads;				///< reads averaged per point
+	double		settle;				///< wait after setting the drive, before reading (s)
+	double		tolerance;			///< stop when the crossing is known to this many volts
+	int			maxPoints;			///< give up after this many points
+
+	KpfmSearchParams() :
+		drive(lsNS5FPOutput1), driveScale(1), error(lsNS5FPOutput2), lo(-2), hi(2),
+		reads(4), settle(0.02), tolerance(0.002), maxPoints(30)
+	{}
+};
+
+
+/// Outcome of KpfmFindZero
+struct KpfmSearchResult
+{
+	bool	found;					///< \c FALSE if the bracket holds no sign change, maxPoints was reached or every read of a point glitched
+	double	potential;				///< drive at the zero crossing (V), NaN if a point could not be read
+	int		points;					///< drive values visited
+	int		reads;					///< reads taken, glitches included
+	double	secs;					///< time taken
+};
+
+
+/// Set the drive, wait, and average \p p.reads non-zero reads of the response; NaN if every read glitched to 0
+template <class Instrument>
+double KpfmReadAt(Instrument& inst, const KpfmSearchParams& p, double v, KpfmSearchResult& r)
+{
+	inst.SetSoft(p.drive, p.driveScale * v);
+	inst.Pause(p.settle);
+	r.points++;
+	double sum = 0;
+	int n = 0;
+	for (int tries=0; n<p.reads && tries<4*p.reads; tries++)
+	{
+		double e = inst.GetSoft(p.error);
+		r.reads++;
+		if (e != 0)
+		{
+			sum += e;
+			n++;
+		}
+	}
+	return n > 0 ? sum / n : NAN;
+}
+
+
+/** \brief Find the drive at which the response crosses zero, see the file description
+*
+* Brent's method: inverse quadratic interpolation where it converges,
+* bisection where it does not, so the search never takes many more points
+* than bisection would. The drive is left at the last point read.
+*/
+template <class Instrument>
+KpfmSearchResult KpfmFindZero(Instrument& inst, const KpfmSearchParams& p)
+{
+	KpfmSearchResult r;
+	r.found = false;
+	r.points = 0;
+	r.reads = 0;
+	double start = inst.Now();
+
+	double a = p.lo, b = p.hi;
+	double fa = KpfmReadAt(inst, p, a, r);
+	double fb = KpfmReadAt(inst, p, b, r);
+	if (fa != fa || fb != fb)
+	{
+		r.potential = NAN;			// a 0 read is a glitch, not a root
+		r.secs = inst.Now() - start;
+		return r;
+	}
+	if ((fa > 0) == (fb > 0))
+	{
+		r.potential = fabs(fa) < fabs(fb) ? a : b;
+		r.secs = inst.Now() - start;
+		return r;
+	}
+	double c = a, fc = fa, d = b - a, e = d;
+	while (r.points < p.maxPoints)
+	{
+		if ((fb > 0) == (fc > 0))
+		{
+			c = a;
+			fc = fa;
+			d = e = b - a;
+		}
+		if (fabs(fc) < fabs(fb))
+		{
+			a = b; b = c; c = a;
+			fa = fb; fb = fc; fc = fa;
+		}
+		double tol = 0.5 * p.tolerance;
+		double m = 0.5 * (c - b);
+		if (fabs(m) <= tol || fb == 0)
+		{
+			r.found = true;
+			break;
+		}
+		if (fabs(e) >= tol && fabs(fa) > fabs(fb))
+		{
+			// interpolation: secant with two points, inverse quadratic with three
+			double s = fb / fa, q, t, pp;
+			if (a == c)
+			{
+				pp = 2 * m * s;
+				q = 1 - s;
+			}
+			else
+			{
+				q = fa / fc;
+				t = fb / fc;
+				pp = s * (2 * m * q * (q - t) - (b - a) * (t - 1));
+				q = (q - 1) * (t - 1) * (s - 1);
+			}
+			if (pp > 0)
+				q = -q;
+			else
+				pp = -pp;
+			if (2 * pp < std::min(3 * m * q - fabs(tol * q), fabs(e * q)))
+			{
+				e = d;
+				d = pp / q;
+			}
+			else
+				d = e = m;
+		}
+		else
+			d = e = m;
+		a = b;
+		fa = fb;
+		b += fabs(d) > tol ? d : (m > 0 ? tol : -tol);
+		fb = KpfmReadAt(inst, p, b, r);
+		if (fb != fb)
+		{
+			b = NAN;
+			break;
+		}
+	}
+	r.potential = b;
+	r.secs = inst.Now() - start;
+	return r;
+}
+
+#endif // __NANOSCRIPT_KPFM_H__
@@ -0,0 +1,267 @@
+/** \file NanoScript_LIMITS.h
+*	\brief Output limits checked before every set, pulse and ramp
+*
+*	The macros mix LithoSet(lsBias, 1000*V) in mV with
+*	LithoSetSoft(lsNS5FPOutput1, V) in volts, and many values come from
+*	settings files. A slip of a factor 1000 goes straight to the sample.
+*	LithoInterlock holds, per output, the allowed range, the largest step of
+*	one set and the largest ramp rate. The Limited versions of the Litho
+*	calls check a value first and refuse it, with a message in the log, if
+*	it is outside the limits:
+*
+*	\li LithoSetLimited, LithoSetSoftLimited, LithoPulseLimited, LithoRampLimited.
+*	\li The helpers go through the same checks: LithoSetAs / LithoPulseAs
+*	(NanoScript_SIGNALS.h), LithoHardware (NanoScript_INSTRUMENT.h),
+*	LithoSweepAcquire, LithoPulseTrain and LithoCalibration::CalibrateOutput.
+*
+*	Limits are in soft units. Values in hard units are converted with a
+*	linear transfer per signal, the identity unless set with HardUnits()
+*	(e.g. from a LithoCalibration). An output without limits costs one
+*	test of a flag per call, one with limits a few compares.
+*
+*	The session limits (LithoLimits()) start with the range of the setup
+*	for lsBias and lsNS5FPOutput1, see LITHO_LIMIT_BIAS and
+*	LITHO_LIMIT_TIP_BIAS, and can be narrowed once at the start of a macro:
+*
+*	example:
+*
+*	LithoLimits().Limit(lsBias, -8000, 8000, 0, 0, "lsBias");	// +-8 V
+*	LithoPulseLimited(lsBias, 1000*Pulse_voltage, Pulse_time);		// refused if Pulse_voltage > 8
+*
+*	Returning an output to zero (LithoSetZero, LithoAbortChannel) is never
+*	refused, but is recorded, so the step check of the next set starts from
+*	zero and not from the value before.
+*/
+
+#ifndef __NANOSCRIPT_LIMITS_H__
+#define __NANOSCRIPT_LIMITS_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include "NanoScript_GUI.h"
+#include "math.h"
+#include "stdio.h"
+
+#ifndef LITHO_LIMIT_BIAS
+#define LITHO_LIMIT_BIAS		10000		// lsBias, +- mV
+#endif
+#ifndef LITHO_LIMIT_TIP_BIAS
+#define LITHO_LIMIT_TIP_BIAS	10			// lsNS5FPOutput1, +- V
+#endif
+
+
+/// Limits of one output
+struct LithoLimit
+{
+	bool		active;			///< \c FALSE: no checks
+	double		lo, hi;			///< allowed range, soft units
+	double		maxStep;		///< largest change of one set or pulse, 0 for any
+	double		maxRate;		///< largest ramp rate in soft units per second, 0 for any
+	double		gain, offset;	///< soft = gain * hard + offset, for calls in hard units
+	bool		known;			///< \c TRUE once a value was set through the checks
+	double		last;			///< that value, soft units
+	long		violations;		///< values refused
+	const char*	name;			///< name in the log messages
+};
+
+
+/** \brief Limits of all outputs, see the file description
+*
+* The checks return \c TRUE if the value may be applied, and \c FALSE after
+* logging the violation otherwise. The step from the previous value is
+* only checked once a value was set through the checks.
+*/
+class LithoInterlock
+{
+public:
+	LithoInterlock()
+	{
+		for (int s=0; s<lsCount; s++)
+		{
+			LithoLimit& l = limits[s];
+			l.active = false;
+			l.lo = l.hi = 0;
+			l.maxStep = l.maxRate = 0;
+			l.gain = 1;
+			l.offset = 0;
+			l.known = false;
+			l.last = 0;
+			l.violations = 0;
+			l.name = 0;
+		}
+	}
+
+	/** \brief Limit an output
+	*
+	* \param lo, hi Allowed range in soft units.
+	* \param maxStep Largest change of one set or pulse, 0 for any.
+	* \param maxRate Largest ramp rate in soft units per second, 0 for any.
+	* \param name Name of the output in the log, e.g. "lsBias".
+	*/
+	void Limit(LithoSignal s, double lo, double hi, double maxStep = 0, double maxRate = 0, const char* name = 0)
+	{
+		LithoLimit& l = limits[s];
+		l.active = true;
+		l.lo = lo < hi ? lo : hi;
+		l.hi = lo < hi ? hi : lo;
+		l.maxStep = maxStep;
+		l.maxRate = maxRate;
+		if (name)
+			l.name = name;
+	}
+
+	/// Remove the limits of an output
+	void Unlimit(LithoSignal s) { limits[s].active = false; }
+
+	/// Transfer of an output for calls in hard units: soft = gain * hard + offset
+	void HardUnits(LithoSignal s, double gain, double offset)
+	{
+		limits[s].gain = gain;
+		limits[s].offset = offset;
+	}
+
+	const LithoLimit& Get(LithoSignal s) const { return limits[s]; }
+
+	/// Values refused so far, all outputs
+	long Violations() const
+	{
+		long n = 0;
+		for (int s=0; s<lsCount; s++)
+			n += limits[s].violations;
+		return n;
+	}
+
+	/// Check a set of the output to \p v
+	bool CheckSet(LithoSignal s, double v, bool soft)
+	{
+		LithoLimit& l = limits[s];
+		if (!l.active)
+			return true;
+		double x = soft ? v : l.gain * v + l.offset;
+		if (x < l.lo || x > l.hi)
+			return Refuse(s, x, "set outside the range");
+		if (l.maxStep > 0 && l.known && fabs(x - l.last) > l.maxStep)
+			return Refuse(s, x, "set, step too large");
+		l.last = x;
+		l.known = true;
+		return true;
+	}
+
+	/// Check a pulse to \p v; the output returns to its value after the pulse
+	bool CheckPulse(LithoSignal s, double v, bool soft)
+	{
+		LithoLimit& l = limits[s];
+		if (!l.active)
+			return true;
+		double x = soft ? v : l.gain * v + l.offset;
+		if (x < l.lo || x > l.hi)
+			return Refuse(s, x, "pulse outside the range");
+		if (l.maxStep > 0 && l.known && fabs(x - l.last) > l.maxStep)
+			return Refuse(s, x, "pulse, step too large");
+		return true;
+	}
+
+	/// Check a ramp from \p from to \p to in \p secs (0: no rate check)
+	bool CheckRamp(LithoSignal s, double from, double to, double secs, bool soft)
+	{
+		LithoLimit& l = limits[s];
+		if (!l.active)
+			return true;
+		double x0 = soft ? from : l.gain * from + l.offset;
+		double x1 = soft ? to : l.gain * to + l.offset;
+		if (x0 < l.lo || x0 > l.hi)
+			return Refuse(s, x0, "ramp start outside the range");
+		if (x1 < l.lo || x1 > l.hi)
+			return Refuse(s, x1, "ramp end outside the range");
+		if (l.maxStep > 0 && l.known && fabs(x0 - l.last) > l.maxStep)
+			return Refuse(s, x0, "ramp start, step too large");
+		if (l.maxRate > 0 && secs > 0 && fabs(x1 - x0) > l.maxRate * secs)
+			return Refuse(s, x1, "ramp too fast");
+		l.last = x1;
+		l.known = true;
+		return true;
+	}
+
+	/// Record that the output was set to \p v without a check, e.g. back to zero
+	void Track(LithoSignal s, double v, bool soft)
+	{
+		LithoLimit& l = limits[s];
+		l.last = soft ? v : l.gain * v + l.offset;
+		l.known = true;
+	}
+
+private:
+	LithoInterlock(const LithoInterlock&);
+	LithoInterlock& operator=(const LithoInterlock&);
+
+	bool Refuse(LithoSignal s, double x, const char* what)
+	{
+		LithoLimit& l = limits[s];
+		l.violations++;
+		char msg[256];
+		if (l.name)
+			_snprintf(msg, sizeof(msg), "Interlock: %s %s: %g (range %g .. %g), refused", l.name, what, x, l.lo, l.hi);
+		else
+			_snprintf(msg, sizeof(msg), "Interlock: signal %d %s: %g (range %g .. %g), refused", (int)s, what, x, l.lo, l.hi);
+		msg[sizeof(msg) - 1] = 0;
+		WriteMsg2Log(2, msg);
+		return false;
+	}
+
+	LithoLimit limits[lsCount];
+};
+
+
+/// The limits of the session, shared by all macros while the DLL is loaded
+inline LithoInterlock& LithoLimits()
+{
+	static LithoInterlock* session = 0;
+	if (!session)
+	{
+		session = new LithoInterlock;
+		session->Limit(lsBias, -LITHO_LIMIT_BIAS, LITHO_LIMIT_BIAS, 0, 0, "lsBias");
+		session->Limit(lsNS5FPOutput1, -LITHO_LIMIT_TIP_BIAS, LITHO_LIMIT_TIP_BIAS, 0, 0, "lsNS5FPOutput1");
+	}
+	return *session;
+}
+
+
+/// LithoSet, if the value is within the limits
+inline bool LithoSetLimited(LithoSignal output, double v)
+{
+	return LithoLimits().CheckSet(output, v, false) && LithoSet(output, v);
+}
+
+/// LithoSetSoft, if the value is within the limits
+inline bool LithoSetSoftLimited(LithoSignal output, double v)
+{
+	return LithoLimits().CheckSet(output, v, true) && LithoSetSoft(output, v);
+}
+
+/// LithoPulse (hard units, like LithoSet), if the value is within the limits
+inline bool LithoPulseLimited(LithoSignal output, double v, double time)
+{
+	return LithoLimits().CheckPulse(output, v, false) && LithoPulse(output, v, time);
+}
+
+/// LithoRamp, if both ends and the rate are within the limits
+inline bool LithoRampLimited(LithoSignal output, double startValue, double endValue, double secs)
+{
+	return LithoLimits().CheckRamp(output, startValue, endValue, secs, false) && LithoRamp(output, startValue, endValue, secs);
+}
+
+/** \brief Set an output back to zero and record it in the limits
+*
+* \param soft \c TRUE: LithoSetSoft, e.g. lsNS5FPOutput1; \c FALSE: LithoSet
+* in hard units, as lsBias in mV.
+*/
+inline bool LithoSetZero(LithoSignal output, bool soft = true)
+{
+	LithoLimits().Track(output, 0, soft);
+	return soft ? LithoSetSoft(output, 0) : LithoSet(output, 0);
+}
+
+#endif // __NANOSCRIPT_LIMITS_H__
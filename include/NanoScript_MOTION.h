@@ -0,0 +1,310 @@
+/** \file NanoScript_MOTION.h
+*	\brief Acceleration limited tip motion from LithoTranslate calls
+*
+*	LithoTranslate moves at one constant rate from start to end. A path of
+*	many segments at that rate stops and starts at full speed at every
+*	corner, and a rate slow enough for the corners crawls along the
+*	straight parts. LithoMotionPlanner queues the segments of a path and
+*	plans it for a maximum acceleration:
+*
+*	\li Every segment has its own rate limit.
+*	\li The speed through a corner follows from the corner angle and the
+*	allowed deviation from the path (\c cornerUm); straight joints keep
+*	the speed, a reversal stops.
+*	\li Entry and exit speeds are limited so that every segment can still
+*	brake in time for the next corner and for the end of the path.
+*	\li Speeding up and braking are split into constant rate pieces, each
+*	at the mean speed of its part of the ramp, so the piece takes the time
+*	the ramp would. Within a piece the tip runs ahead of or behind the
+*	ramp by up to dv^2 / (8 accel) for a speed change dv; a ramp gets as
+*	few pieces as keep that within \c lagUm, often one.
+*	\li Pieces in the same direction at the same rate are merged, so a
+*	straight run of segments at full speed is one call.
+*
+*	Execute issues the calls on any instrument with Translate and Now
+*	(NanoScript_INSTRUMENT.h) and reports the planned against the measured
+*	time.
+*
+*	example, a square at 10 um/s drawn from its corner:
+*
+*	LithoMotionPlanner plan(50);					// 50 um/s^2
+*	plan.LineTo(5, 0, 10);
+*	plan.LineTo(5, 5, 10);
+*	plan.LineTo(0, 5, 10);
+*	plan.LineTo(0, 0, 10);
+*	LithoHardware afm;
+*	LithoMotionReport r;
+*	plan.Execute(afm, r);
+*/
+
+#ifndef __NANOSCRIPT_MOTION_H__
+#define __NANOSCRIPT_MOTION_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include "math.h"
+#include <vector>
+
+
+/// One LithoTranslate call
+struct LithoMove
+{
+	double	dx, dy;			///< microns
+	double	rate;			///< microns per second
+};
+
+
+/// Outcome of LithoMotionPlanner::Execute
+struct LithoMotionReport
+{
+	int		segments;		///< segments queued
+	int		calls;			///< translate calls planned
+	int		done;			///< translate calls that succeeded
+	double	plannedSecs;	///< time of the planned calls
+	double	executedSecs;	///< measured time of the calls
+	double	constantSecs;	///< time of one call per segment at its rate limit, ignoring acceleration
+};
+
+
+/// Plans a path of segments, see the file description
+class LithoMotionPlanner
+{
+public:
+	/** \param accel Maximum acceleration, microns per second squared.
+	* \param cornerUm Allowed deviation from the path at a corner, microns.
+	* \param lagUm Largest distance the tip may run ahead of or behind a ramp, microns; 0 for one piece per ramp.
+	* \param minPieceUm Pieces shorter than this are merged into their neighbour.
+	*/
+	explicit LithoMotionPlanner(double accel = 50, double cornerUm = 0.05, double lagUm = 0.2, double minPieceUm = 0.005) :
+		a(accel), corner(cornerUm), lag(lagUm), minPiece(minPieceUm), x(0), y(0), planned(false)
+	{}
+
+	/// Position the path starts from, relative moves are computed from it
+	void Start(double xUm, double yUm)
+	{
+		Clear();
+		x = xUm;
+		y = yUm;
+	}
+
+	/// Queue a straight segment to (xUm, yUm) at no more than \p rateUmPerSec
+	void LineTo(double xUm, double yUm, double rateUmPerSec)
+	{
+		Segment s;
+		s.dx = xUm - x;
+		s.dy = yUm - y;
+		s.length = sqrt(s.dx * s.dx + s.dy * s.dy);
+		s.rate = rateUmPerSec;
+		s.stop = false;
+		x = xUm;
+		y = yUm;
+		if (s.length <= 0 || rateUmPerSec <= 0)
+			return;
+		segments.push_back(s);
+		planned = false;
+	}
+
+	/// Queue a segment relative to the end of the last one
+	void LineBy(double dxUm, double dyUm, double rateUmPerSec) { LineTo(x + dxUm, y + dyUm, rateUmPerSec); }
+
+	/// Come to a stop at the end of the last queued segment, e.g. for a measurement
+	void Stop()
+	{
+		if (!segments.empty())
+		{
+			segments.back().stop = true;
+			planned = false;
+		}
+	}
+
+	/// Drop the queued segments; the position stays at the end of the path
+	void Clear()
+	{
+		segments.clear();
+		moves.clear();
+		planned = false;
+	}
+
+	int Segments() const { return (int)segments.size(); }
+
+	/// The translate calls, planned if needed
+	const std::vector<LithoMove>& Moves()
+	{
+		Plan();
+		return moves;
+	}
+
+	/// Time of the planned calls, seconds
+	double PlannedSecs()
+	{
+		Plan();
+		double secs = 0;
+		for (size_t i=0; i<moves.size(); i++)
+			secs += sqrt(moves[i].dx * moves[i].dx + moves[i].dy * moves[i].dy) / moves[i].rate;
+		return secs;
+	}
+
+	/// Time at a constant rate per segment, as one LithoTranslate per segment would take
+	double ConstantSecs() const
+	{
+		double secs = 0;
+		for (size_t i=0; i<segments.size(); i++)
+			secs += segments[i].length / segments[i].rate;
+		return secs;
+	}
+
+	/** \brief Issue the planned calls and clear the queue
+	*
+	* \param inst Any instrument with bool Translate(dx, dy, rate) and double Now().
+	* \return \c FALSE if a call failed; the rest of the path is dropped.
+	*/
+	template <class Instrument>
+	bool Execute(Instrument& inst, LithoMotionReport& r)
+	{
+		Plan();
+		r.segments = (int)segments.size();
+		r.calls = (int)moves.size();
+		r.done = 0;
+		r.plannedSecs = PlannedSecs();
+		r.constantSecs = ConstantSecs();
+		double start = inst.Now();
+		bool ok = true;
+		for (size_t i=0; i<moves.size() && ok; i++)
+		{
+			ok = inst.Translate(moves[i].dx, moves[i].dy, moves[i].rate);
+			if (ok)
+				r.done++;
+		}
+		r.executedSecs = inst.Now() - start;
+		Clear();
+		return ok;
+	}
+
+private:
+	struct Segment
+	{
+		double	dx, dy, length, rate;
+		bool	stop;			///< speed 0 at the end
+	};
+
+	/// Highest speed through the joint of two segments
+	double CornerRate(const Segment& s, const Segment& t) const
+	{
+		double limit = s.rate < t.rate ? s.rate : t.rate;
+		if (s.stop)
+			return 0;
+		// cosine of the angle between the incoming and the reversed outgoing direction
+		double c = -(s.dx * t.dx + s.dy * t.dy) / (s.length * t.length);
+		if (c < -0.999999)
+			return limit;		// straight on
+		double sinHalf = sqrt(0.5 * (1 - c));
+		if (sinHalf > 0.999999)
+			return limit;
+		double v = sqrt(a * corner * sinHalf / (1 - sinHalf));
+		return v < limit ? v : limit;
+	}
+
+	/// Add a constant rate piece along the unit vector (ux, uy), merging it where possible
+	void AddPiece(double ux, double uy, double length, double rate)
+	{
+		if (length <= 0 || rate <= 0)
+			return;
+		LithoMove m = { ux * length, uy * length, rate };
+		if (!moves.empty())
+		{
+			LithoMove& last = moves.back();
+			double ll = sqrt(last.dx * last.dx + last.dy * last.dy);
+			bool same = fabs(last.rate - rate) <= 1e-9 * rate
+					 && fabs(last.dx * uy - last.dy * ux) <= 1e-9 * ll
+					 && last.dx * ux + last.dy * uy > 0;
+			if (same || length < minPiece)
+			{
+				last.dx += m.dx;
+				last.dy += m.dy;
+				return;
+			}
+			if (ll < minPiece)
+			{
+				last.dx += m.dx;
+				last.dy += m.dy;
+				last.rate = rate;
+				return;
+			}
+		}
+		moves.push_back(m);
+	}
+
+	/// Constant rate pieces of a ramp from speed v0 to v1 (either may be the larger), each within the lag
+	void AddRamp(double ux, double uy, double v0, double v1)
+	{
+		double dv = fabs(v1 - v0);
+		if (dv <= 0)
+			return;
+		int k = lag > 0 ? (int)ceil(dv / sqrt(8 * a * lag)) : 1;
+		if (k < 1)
+			k = 1;
+		for (int j=0; j<k; j++)
+		{
+			double va = v0 + (v1 - v0) * j / k, vb = v0 + (v1 - v0) * (j + 1) / k;
+			AddPiece(ux, uy, fabs(vb * vb - va * va) / (2 * a), 0.5 * (va + vb));
+		}
+	}
+
+	/// Speeds at the joints, then the pieces of every segment
+	void Plan()
+	{
+		if (planned)
+			return;
+		planned = true;
+		moves.clear();
+		size_t n = segments.size();
+		if (n == 0)
+			return;
+
+		// v[i]: speed at the start of segment i, v[n] = 0 at the end of the path
+		std::vector<double> v(n + 1, 0);
+		for (size_t i=1; i<n; i++)
+			v[i] = CornerRate(segments[i - 1], segments[i]);
+		for (size_t i=n; i-->0;)			// braking
+		{
+			double reach = sqrt(v[i + 1] * v[i + 1] + 2 * a * segments[i].length);
+			if (v[i] > reach)
+				v[i] = reach;
+		}
+		for (size_t i=0; i<n; i++)			// speeding up
+		{
+			double reach = sqrt(v[i] * v[i] + 2 * a * segments[i].length);
+			if (v[i + 1] > reach)
+				v[i + 1] = reach;
+		}
+
+		for (size_t i=0; i<n; i++)
+		{
+			const Segment& s = segments[i];
+			double ux = s.dx / s.length, uy = s.dy / s.length;
+			double v0 = v[i], v1 = v[i + 1], vc = s.rate;
+			double up = (vc * vc - v0 * v0) / (2 * a), down = (vc * vc - v1 * v1) / (2 * a);
+			if (up + down > s.length)
+			{
+				// no room to reach the rate limit: triangle profile
+				vc = sqrt(a * s.length + 0.5 * (v0 * v0 + v1 * v1));
+				up = (vc * vc - v0 * v0) / (2 * a);
+				down = (vc * vc - v1 * v1) / (2 * a);
+			}
+			AddRamp(ux, uy, v0, vc);
+			AddPiece(ux, uy, s.length - up - down, vc);
+			AddRamp(ux, uy, vc, v1);
+		}
+	}
+
+	double a, corner, lag, minPiece;
+	double x, y;					///< end of the queued path
+	std::vector<Segment> segments;
+	std::vector<LithoMove> moves;
+	bool planned;
+};
+
+#endif // __NANOSCRIPT_MOTION_H__
@@ -0,0 +1,254 @@
+/** \file NanoScript_PHASE.h
+*	\brief Phase unwrapping and vector averaging of lock-in amplitude and phase
+*
+*	The lock-in phase wraps at +-180 degrees. Averaging it as a number
+*	gives 0 for two reads of 179 and -179 degrees, and a phase that drifts
+*	slowly across the wrap jumps by 360 degrees.
+*
+*	\li LithoPhaseUnwrapper follows a stream of phases and adds whole turns
+*	so that consecutive values never differ by more than half a turn. Only
+*	for signals that really are continuous: the 180 degree jumps of
+*	polarization switching in a PFM loop are ambiguous to it and make the
+*	unwrapped phase drift by whole turns, so loops keep the wrapped phase.
+*	\li LithoPolarToXY converts blocks of (R, theta) to (X, Y) in one loop
+*	without branches, which the compiler can vectorize.
+*	\li LithoVectorMean averages in X and Y; its amplitude and phase are
+*	those of the mean vector, so the wrap does not matter and noise does
+*	not bias the amplitude upwards the way averaging R does.
+*	\li LithoVectorAverageUntil reads amplitude and phase in blocks until
+*	the mean vector is known well enough, like LithoAverageUntil
+*	(NanoScript_AVERAGE.h).
+*
+*	example:
+*
+*	LithoVectorAverage v = LithoVectorAverageUntil(
+*		[]{ return LithoReadChannel<PfmAmplitude>().value; },	// mV
+*		[]{ return LithoReadChannel<PfmPhase>().value; },		// degrees
+*		0.2, 0.5, 3, 30);
+*	// v.phase: -180 .. 180, the phase of the mean vector
+*/
+
+#ifndef __NANOSCRIPT_PHASE_H__
+#define __NANOSCRIPT_PHASE_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "math.h"
+
+#define LITHO_DEGREE		(3.14159265358979323846 / 180)		// radians per degree
+#define LITHO_VECTOR_BLOCK	32									// reads per block at most
+
+
+/// Removes the jumps of a wrapped phase from a stream of values
+class LithoPhaseUnwrapper
+{
+public:
+	/// \param period One turn in the units of the phase, 360 for degrees.
+	explicit LithoPhaseUnwrapper(double period = 360) : turn(period), offset(0), last(0), started(false) {}
+
+	/// Unwrap one value. \return The value plus the whole turns that keep it within half a turn of the previous one.
+	double Unwrap(double phase)
+	{
+		if (!started)
+		{
+			started = true;
+			offset = 0;
+			last = phase;
+			return phase;
+		}
+		double u = phase + offset;
+		offset -= turn * floor((u - last) / turn + 0.5);
+		last = phase + offset;
+		return last;
+	}
+
+	/// Unwrap a block of values, in place if \p out is \p in
+	void Unwrap(const double* in, double* out, int n)
+	{
+		for (int i=0; i<n; i++)
+			out[i] = Unwrap(in[i]);
+	}
+
+	/// Last unwrapped value
+	double Last() const { return last; }
+
+	/// Start a new stream
+	void Clear()
+	{
+		started = false;
+		offset = 0;
+	}
+
+private:
+	double turn, offset, last;
+	bool started;
+};
+
+
+/** \brief Convert a block of amplitudes and phases to X and Y
+*
+* \param thetaScale Radians per unit of the phase, LITHO_DEGREE for degrees.
+*/
+inline void LithoPolarToXY(const double* r, const double* theta, double* x, double* y, int n,
+						   double thetaScale = LITHO_DEGREE)
+{
+	for (int i=0; i<n; i++)
+	{
+		double a = thetaScale * theta[i];
+		x[i] = r[i] * cos(a);
+		y[i] = r[i] * sin(a);
+	}
+}
+
+
+/// Mean vector of a set of reads
+struct LithoVectorAverage
+{
+	double	x, y;			///< mean X and Y, units of the amplitude
+	double	amplitude;		///< length of the mean vector
+	double	phase;			///< angle of the mean vector in degrees, -180 .. 180
+	double	sem;			///< standard error of the mean vector, units of the amplitude
+	double	phaseSem;		///< the same as an angle in degrees, 180 if the mean is 0
+	int		count;			///< reads taken
+	bool	reached;		///< \c TRUE if both targets were met before maxReads
+};
+
+
+/// Accumulates X and Y, see the file description
+class LithoVectorMean
+{
+public:
+	LithoVectorMean() { Clear(); }
+
+	void Add(double x, double y)
+	{
+		n++;
+		sx += x;
+		sy += y;
+		sxx += x * x;
+		syy += y * y;
+	}
+
+	/// Add a block of X, Y pairs
+	void Add(const double* x, const double* y, int count)
+	{
+		double bx = 0, by = 0, bxx = 0, byy = 0;
+		for (int i=0; i<count; i++)
+		{
+			bx += x[i];
+			by += y[i];
+			bxx += x[i] * x[i];
+			byy += y[i] * y[i];
+		}
+		n += count;
+		sx += bx;
+		sy += by;
+		sxx += bxx;
+		syy += byy;
+	}
+
+	/// Add a block of amplitudes and phases in degrees
+	void AddPolar(const double* r, const double* theta, int count)
+	{
+		double x[LITHO_VECTOR_BLOCK], y[LITHO_VECTOR_BLOCK];
+		for (int i=0; i<count; i+=LITHO_VECTOR_BLOCK)
+		{
+			int m = count - i < LITHO_VECTOR_BLOCK ? count - i : LITHO_VECTOR_BLOCK;
+			LithoPolarToXY(r + i, theta + i, x, y, m);
+			Add(x, y, m);
+		}
+	}
+
+	int Count() const { return n; }
+
+	LithoVectorAverage Result() const
+	{
+		LithoVectorAverage v;
+		v.count = n;
+		v.reached = false;
+		v.x = n > 0 ? sx / n : 0;
+		v.y = n > 0 ? sy / n : 0;
+		v.amplitude = sqrt(v.x * v.x + v.y * v.y);
+		v.phase = v.amplitude > 0 ? atan2(v.y, v.x) / LITHO_DEGREE : 0;
+		double var = 0;
+		if (n > 1)
+		{
+			var = (sxx - n * v.x * v.x + syy - n * v.y * v.y) / (n - 1);
+			if (var < 0)
+				var = 0;			// rounding
+		}
+		v.sem = n > 1 ? sqrt(var / n) : 0;
+		v.phaseSem = v.amplitude > v.sem ? asin(v.sem / v.amplitude) / LITHO_DEGREE : 180;
+		return v;
+	}
+
+	void Clear()
+	{
+		n = 0;
+		sx = sy = sxx = syy = 0;
+	}
+
+private:
+	int n;
+	double sx, sy, sxx, syy;
+};
+
+
+/** \brief Read amplitude and phase until the mean vector is known well enough
+*
+* Reads come in blocks (the first of \p minReads, then of \p block), each
+* converted and added in one pass.
+*
+* \param readR, readTheta Callables returning one amplitude and one phase in degrees.
+* \param targetSem Target standard error of the mean vector, units of the amplitude.
+* \param targetPhaseSem Target standard error of its angle, degrees.
+* \param minReads Read pairs taken in any case (at least 2).
+* \param maxReads Read pairs taken at most.
+* \param block Read pairs per further block, at most LITHO_VECTOR_BLOCK.
+*/
+template <class ReadR, class ReadTheta>
+LithoVectorAverage LithoVectorAverageUntil(ReadR readR, ReadTheta readTheta, double targetSem, double targetPhaseSem,
+										   int minReads = 3, int maxReads = 30, int block = 1)
+{
+	if (minReads < 2)
+		minReads = 2;
+	if (maxReads < minReads)
+		maxReads = minReads;
+	if (block < 1)
+		block = 1;
+	if (block > LITHO_VECTOR_BLOCK)
+		block = LITHO_VECTOR_BLOCK;
+
+	LithoVectorMean mean;
+	double r[LITHO_VECTOR_BLOCK], theta[LITHO_VECTOR_BLOCK];
+	LithoVectorAverage v;
+	int todo = minReads;
+	for (;;)
+	{
+		while (todo > 0)
+		{
+			int m = todo < LITHO_VECTOR_BLOCK ? todo : LITHO_VECTOR_BLOCK;
+			for (int i=0; i<m; i++)
+			{
+				r[i] = readR();
+				theta[i] = readTheta();
+			}
+			mean.AddPolar(r, theta, m);
+			todo -= m;
+		}
+		v = mean.Result();
+		if (v.sem <= targetSem && v.phaseSem <= targetPhaseSem)
+		{
+			v.reached = true;
+			break;
+		}
+		if (v.count >= maxReads)
+			break;
+		todo = maxReads - v.count < block ? maxReads - v.count : block;
+	}
+	return v;
+}
+
+#endif // __NANOSCRIPT_PHASE_H__
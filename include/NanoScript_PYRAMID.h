@@ -0,0 +1,296 @@
+/** \file NanoScript_PYRAMID.h
+*	\brief Min/max/mean pyramid of a long time series
+*
+*	An overnight recording holds tens of millions of samples; showing it
+*	means reading all of them. LithoPyramidWriter keeps summaries of the
+*	series at several resolutions while it is written: level 1 holds one
+*	bin (time span, min, max, sum, count) per \c factor samples, level 2 one
+*	per factor^2 samples, and so on. Each level is a file of fixed size
+*	records next to the raw data (<base>.pyr1, <base>.pyr2, ...).
+*
+*	LithoPyramidReader summarizes any time window into a given number of
+*	bins (e.g. the screen width in pixels) from the coarsest level that
+*	still has enough resolution, so the work is proportional to the number
+*	of bins, not to the number of samples.
+*
+*	example:
+*
+*	LithoPyramidWriter pyr;
+*	pyr.Create("Relaxor");
+*	for (...)
+*	{
+*		myfile1 << t << "\t" << v << "\n";	// raw data as before
+*		pyr.Add(t, v);
+*	}
+*	pyr.Close();
+*
+*	LithoPyramidReader view;
+*	view.Open("Relaxor");
+*	std::vector<LithoPyramidBin> bins;
+*	view.Summarize(0, 36000, 1000, bins);	// 10 hours in 1000 bins
+*/
+
+#ifndef __NANOSCRIPT_PYRAMID_H__
+#define __NANOSCRIPT_PYRAMID_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_FILE.h"
+#include "stdio.h"
+#include <string>
+#include <vector>
+
+#define LITHO_PYRAMID_LEVELS	6			// at most
+
+
+/// Summary of the samples in a time span
+struct LithoPyramidBin
+{
+	double		t0, t1;			///< time of the first and last sample
+	double		min, max;
+	double		sum;
+	long long	count;			///< samples in the bin, 0 for an empty bin
+
+	double Mean() const { return count > 0 ? sum / count : 0; }
+
+	/// Include the samples of another bin that follows this one in time
+	void Merge(const LithoPyramidBin& b)
+	{
+		if (b.count == 0)
+			return;
+		if (count == 0)
+		{
+			*this = b;
+			return;
+		}
+		t1 = b.t1;
+		if (b.min < min) min = b.min;
+		if (b.max > max) max = b.max;
+		sum += b.sum;
+		count += b.count;
+	}
+};
+
+
+/// Name of the file of one level
+inline std::string LithoPyramidFile(const char* base, int level)
+{
+	char suffix[16];
+	sprintf(suffix, ".pyr%d", level);
+	return std::string(base) + suffix;
+}
+
+
+/// Writes the pyramid of a series while it is recorded, see the file description
+class LithoPyramidWriter
+{
+public:
+	LithoPyramidWriter() : factor(16), levels(0) {}
+
+	~LithoPyramidWriter() { Close(); }
+
+	/** \brief Start a new pyramid, replacing an old one of the same name
+	*
+	* \param base Name of the series; the level files get .pyr1, .pyr2, ... appended.
+	* \param binFactor Samples (or bins of the level below) per bin.
+	* \param nLevels Number of levels, at most LITHO_PYRAMID_LEVELS.
+	*/
+	bool Create(const char* base, int binFactor = 16, int nLevels = 5)
+	{
+		Close();
+		factor = binFactor < 2 ? 2 : binFactor;
+		levels = nLevels < 1 ? 1 : nLevels > LITHO_PYRAMID_LEVELS ? LITHO_PYRAMID_LEVELS : nLevels;
+		for (int l=0; l<levels; l++)
+		{
+			files[l] = fopen(LithoPyramidFile(base, l + 1).c_str(), "wb");
+			open[l].count = 0;
+			members[l] = 0;
+			if (!files[l])
+			{
+				levels = l;
+				Close();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/// Add one sample; samples must come in time order
+	void Add(double t, double v)
+	{
+		if (levels == 0)
+			return;
+		LithoPyramidBin b;
+		b.t0 = b.t1 = t;
+		b.min = b.max = b.sum = v;
+		b.count = 1;
+		Push(0, b);
+	}
+
+	/** \brief Write the bins still open and close the files
+	*
+	* The open bins hold fewer samples than a full bin. They are written
+	* from the bottom level up, each passed on to the level above before it
+	* is written, so every level ends with all the samples.
+	*/
+	void Close()
+	{
+		for (int l=0; l<levels; l++)
+		{
+			if (open[l].count > 0)
+				Emit(l, true);
+			fclose(files[l]);
+		}
+		levels = 0;
+	}
+
+private:
+	LithoPyramidWriter(const LithoPyramidWriter&);
+	LithoPyramidWriter& operator=(const LithoPyramidWriter&);
+
+	void Push(int l, const LithoPyramidBin& b)
+	{
+		open[l].Merge(b);
+		if (++members[l] == factor)
+			Emit(l, true);
+	}
+
+	/// Write the open bin of level l and pass it on to the level above
+	void Emit(int l, bool full)
+	{
+		fwrite(&open[l], sizeof(LithoPyramidBin), 1, files[l]);
+		if (l >= 1)
+			fflush(files[l]);		// readers see the recording up to the last level 2 bin
+		if (full && l + 1 < levels)
+			Push(l + 1, open[l]);
+		open[l].count = 0;
+		members[l] = 0;
+	}
+
+	int factor, levels;
+	FILE* files[LITHO_PYRAMID_LEVELS];
+	LithoPyramidBin open[LITHO_PYRAMID_LEVELS];
+	int members[LITHO_PYRAMID_LEVELS];
+};
+
+
+/// Reads a pyramid, see the file description
+class LithoPyramidReader
+{
+public:
+	LithoPyramidReader() : levels(0) {}
+
+	~LithoPyramidReader() { Close(); }
+
+	/// Open the level files of a series. \return \c FALSE if there is no level 1.
+	bool Open(const char* base)
+	{
+		Close();
+		for (int l=0; l<LITHO_PYRAMID_LEVELS; l++)
+		{
+			files[l] = fopen(LithoPyramidFile(base, l + 1).c_str(), "rb");
+			if (!files[l])
+				break;
+			levels = l + 1;
+		}
+		return levels > 0;
+	}
+
+	void Close()
+	{
+		for (int l=0; l<levels; l++)
+			fclose(files[l]);
+		levels = 0;
+	}
+
+	int Levels() const { return levels; }
+
+	/// Number of bins of a level written so far
+	long long Bins(int level)
+	{
+		FILE* f = files[level - 1];
+		LITHO_FSEEK(f, 0, SEEK_END);
+		return LITHO_FTELL(f) / (long long)sizeof(LithoPyramidBin);
+	}
+
+	/// Bin \p i of a level
+	bool Bin(int level, long long i, LithoPyramidBin& b)
+	{
+		FILE* f = files[level - 1];
+		return LITHO_FSEEK(f, i * (long long)sizeof(LithoPyramidBin), SEEK_SET) == 0
+			&& fread(&b, sizeof(LithoPyramidBin), 1, f) == 1;
+	}
+
+	/// First bin of a level that ends at or after time t (binary search)
+	long long Find(int level, double t)
+	{
+		long long lo = 0, hi = Bins(level);
+		LithoPyramidBin b;
+		while (lo < hi)
+		{
+			long long mid = lo + (hi - lo) / 2;
+			if (Bin(level, mid, b) && b.t1 < t)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+
+	/** \brief Summarize the samples between t0 and t1 into \p width bins of equal time span
+	*
+	* Uses the coarsest level with at least \p width bins in the window, so
+	* at most factor * width bins are read. Level bins that straddle a
+	* border of the output bins are counted in the one holding their start;
+	* a level bin that starts before \p t0 but reaches into the window is
+	* counted in the first output bin.
+	*
+	* \return The level used, 0 if nothing was found.
+	*/
+	int Summarize(double t0, double t1, int width, std::vector<LithoPyramidBin>& out)
+	{
+		LithoPyramidBin empty = { 0, 0, 0, 0, 0, 0 };
+		out.assign(width > 0 ? width : 0, empty);
+		if (levels == 0 || width <= 0 || t1 <= t0)
+			return 0;
+		int level = 1;
+		long long first = 0, last = 0;
+		for (int l=levels; l>=1; l--)
+		{
+			first = Find(l, t0);
+			last = Find(l, t1);
+			if (last - first >= width || l == 1)
+			{
+				level = l;
+				break;
+			}
+		}
+		long long n = Bins(level);
+		FILE* f = files[level - 1];
+		LITHO_FSEEK(f, first * (long long)sizeof(LithoPyramidBin), SEEK_SET);
+		LithoPyramidBin b;
+		for (long long i=first; i<n && fread(&b, sizeof(LithoPyramidBin), 1, f) == 1; i++)
+		{
+			if (b.t0 > t1)
+				break;
+			if (b.t1 < t0)
+				continue;
+			int k = b.t0 < t0 ? 0 : (int)((b.t0 - t0) / (t1 - t0) * width);
+			if (k >= width)
+				k = width - 1;
+			out[k].Merge(b);
+		}
+		return level;
+	}
+
+private:
+	LithoPyramidReader(const LithoPyramidReader&);
+	LithoPyramidReader& operator=(const LithoPyramidReader&);
+
+	int levels;
+	FILE* files[LITHO_PYRAMID_LEVELS];
+};
+
+#endif // __NANOSCRIPT_PYRAMID_H__
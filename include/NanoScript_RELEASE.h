@@ -0,0 +1,93 @@
+/** \file NanoScript_RELEASE.h
+*	\brief Scoped capture of the lithography process
+*
+*	LithoRelease(false) improves the timing of LithoPause, LithoPulse and
+*	short waits, but locks out all user access until LithoRelease(true)
+*	is called again. Forgetting the second call (or leaving the block
+*	through LithoAbort or an exception) leaves the GUI unusable.
+*
+*	LithoCriticalSection captures the process in its constructor and
+*	always releases it in its destructor, so the capture is limited to the
+*	enclosing scope whatever way the scope is left.
+*
+*	example:
+*
+*	LITHO_BEGIN
+*	...
+*	{
+*		LithoCriticalSection cs;		// process captured
+*		LithoPulse(lsBias, 1000*v, 0.01);
+*		amp = LithoGetSoft(lsNS5FPOutput1);
+*	}									// process released
+*	Sleep(300);							// long waits outside the section
+*	...
+*	LITHO_END
+*
+*	Keep the section as short as possible: only the pulse and the reads
+*	that must follow it with a fixed delay. Long Sleep() calls belong
+*	outside of it.
+*/
+
+#ifndef __NANOSCRIPT_RELEASE_H__
+#define __NANOSCRIPT_RELEASE_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+
+
+/** \brief Capture the lithography process for the lifetime of the object
+*
+* Sections may be nested; only the outermost one captures and releases
+* the process.
+*/
+class LithoCriticalSection
+{
+public:
+	/** \brief Capture the process
+	*
+	* \param enable Pass \c FALSE to make the section a no-op. This allows
+	* the same code path to be timed with and without the capture.
+	*/
+	explicit LithoCriticalSection(bool enable = true) : owner(false)
+	{
+		if (enable && Depth() == 0)
+		{
+			LithoRelease(false);
+			owner = true;
+		}
+		if (enable)
+			Depth()++;
+		active = enable;
+	}
+
+	/// Release the process again if this is the outermost section
+	~LithoCriticalSection()
+	{
+		if (!active)
+			return;
+		Depth()--;
+		if (owner)
+			LithoRelease(true);
+	}
+
+	/// \c TRUE while any section is active
+	static bool IsCaptured() { return Depth() > 0; }
+
+private:
+	LithoCriticalSection(const LithoCriticalSection&);
+	LithoCriticalSection& operator=(const LithoCriticalSection&);
+
+	static int& Depth()
+	{
+		static int depth = 0;
+		return depth;
+	}
+
+	bool owner;
+	bool active;
+};
+
+#endif // __NANOSCRIPT_RELEASE_H__
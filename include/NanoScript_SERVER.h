@@ -0,0 +1,144 @@
+/** \file NanoScript_SERVER.h
+*	\brief Request channel of the resident macro server
+*
+*	Every macro run loads the DLL, calls LithoBegin and unloads again when
+*	macroMain returns 0. "Macro Server.cpp" stays loaded instead (returns 1)
+*	and serves experiment requests from other programs over a named pipe.
+*
+*	The requests of one run share one Litho session. A run still calls
+*	LithoBegin and LithoEnd, and the session is not kept between runs: a
+*	later run only saves loading the DLL. The pipe exists while a run serves
+*	requests; between runs a client finds no server.
+*
+*	Protocol: the client connects, writes one request line and reads one
+*	reply line, then the server disconnects. A request is a queue line
+*	(NanoScript_BATCH.h) or one of the commands \c ping, \c stats, \c quit.
+*	The reply is
+*
+*	\code
+*	<ok|fail> <run_s> <dispatch_s> <message>
+*	\endcode
+*
+*	where dispatch_s is the time from receiving the request to starting the
+*	experiment, i.e. the startup latency of a request.
+*
+*	The pipe is non-blocking, so the server can poll it between calls that
+*	let Nanoscope abort the macro.
+*/
+
+#ifndef __NANOSCRIPT_SERVER_H__
+#define __NANOSCRIPT_SERVER_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "windows.h"
+#include "NanoScript_TIMING.h"
+#include <string>
+
+#define LITHO_SERVER_PIPE		"\\\\.\\pipe\\NanoScriptMacro"
+#define LITHO_SERVER_LINE		4096			// longest request or reply
+
+
+/// Server end of the request pipe, one client at a time
+class LithoRequestPipe
+{
+public:
+	LithoRequestPipe() : pipe(INVALID_HANDLE_VALUE), connected(false) {}
+
+	~LithoRequestPipe() { Close(); }
+
+	/// Create the pipe. \return \c FALSE if it exists already (another server runs) or cannot be created.
+	bool Open()
+	{
+		if (pipe != INVALID_HANDLE_VALUE)
+			return true;
+		pipe = CreateNamedPipeA(LITHO_SERVER_PIPE, PIPE_ACCESS_DUPLEX | FILE_FLAG_FIRST_PIPE_INSTANCE,
+								PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_NOWAIT, 1,
+								LITHO_SERVER_LINE, LITHO_SERVER_LINE, 0, 0);
+		return pipe != INVALID_HANDLE_VALUE;
+	}
+
+	void Close()
+	{
+		Disconnect();
+		if (pipe != INVALID_HANDLE_VALUE)
+			CloseHandle(pipe);
+		pipe = INVALID_HANDLE_VALUE;
+	}
+
+	bool IsOpen() const { return pipe != INVALID_HANDLE_VALUE; }
+
+	/// Check for a client without waiting. \return \c TRUE if one is connected.
+	bool Poll()
+	{
+		if (connected)
+			return true;
+		if (pipe == INVALID_HANDLE_VALUE)
+			return false;
+		// non-blocking: fails with ERROR_PIPE_LISTENING while nobody is there
+		if (ConnectNamedPipe(pipe, 0) || GetLastError() == ERROR_PIPE_CONNECTED)
+			connected = true;
+		else if (GetLastError() == ERROR_NO_DATA)
+			DisconnectNamedPipe(pipe);		// a client came and went, listen again
+		return connected;
+	}
+
+	/** \brief Read the request line of the connected client
+	*
+	* \param line Receives the line without the line end.
+	* \param timeout Seconds to wait for the complete line.
+	*
+	* \return \c FALSE if the client did not send a line in time.
+	*/
+	bool ReadLine(std::string& line, double timeout = 2)
+	{
+		line.clear();
+		double deadline = LithoNow() + timeout;
+		char c;
+		DWORD n;
+		while (line.size() < LITHO_SERVER_LINE)
+		{
+			if (ReadFile(pipe, &c, 1, &n, 0) && n == 1)
+			{
+				if (c == '\n')
+					return true;
+				if (c != '\r')
+					line += c;
+			}
+			else if (GetLastError() != ERROR_NO_DATA || LithoNow() > deadline)
+				return false;
+			else
+				Sleep(1);
+		}
+		return false;
+	}
+
+	/// Send the reply line; a line end is appended
+	bool WriteLine(const std::string& line)
+	{
+		std::string text = line + "\n";
+		DWORD n = 0;
+		return WriteFile(pipe, text.c_str(), (DWORD)text.size(), &n, 0) && n == text.size();
+	}
+
+	/// Finish with the current client
+	void Disconnect()
+	{
+		if (!connected)
+			return;
+		FlushFileBuffers(pipe);
+		DisconnectNamedPipe(pipe);
+		connected = false;
+	}
+
+private:
+	LithoRequestPipe(const LithoRequestPipe&);
+	LithoRequestPipe& operator=(const LithoRequestPipe&);
+
+	HANDLE pipe;
+	bool connected;
+};
+
+#endif // __NANOSCRIPT_SERVER_H__
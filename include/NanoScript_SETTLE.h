@@ -0,0 +1,132 @@
+/** \file NanoScript_SETTLE.h
+*	\brief Wait until a signal has settled instead of sleeping a fixed time
+*
+*	LithoWaitFor only ends a wait when a signal drops below a level.
+*	After a pulse or a scan toggle what we actually want is to wait until the
+*	lock-in output has stopped moving. LithoWaitSettled samples the signal,
+*	keeps a sliding window of the most recent samples and returns as soon as
+*	both the scatter and the drift over the window are within a tolerance,
+*	or when the timeout expires. Between samples the thread sleeps: the fit
+*	uses the measured sample times, so they need not be on an exact clock.
+*
+*	Only the one signal is checked. When amplitude and phase are read after
+*	the wait, the phase may still be moving; wait on the phase as well where
+*	it settles more slowly.
+*
+*	example:
+*
+*	LithoPulse(lsBias, 1000*v, 0.1);
+*	LithoSettleResult st = LithoWaitSettled(lsNS5FPOutput1, 0.0005, 0.3);
+*	myfile << st.secs;			// actual settle time, <= 0.3 s
+*/
+
+#ifndef __NANOSCRIPT_SETTLE_H__
+#define __NANOSCRIPT_SETTLE_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include "NanoScript_TIMING.h"
+#include "math.h"
+#include <vector>
+
+
+/// Outcome of LithoWaitSettled
+struct LithoSettleResult
+{
+	bool	settled;	///< \c TRUE if the signal settled before the timeout
+	double	secs;		///< time spent waiting, in seconds
+	double	value;		///< mean of the signal over the final window
+	double	stddev;		///< standard deviation over the final window
+	double	drift;		///< change of the fitted line over the final window
+	int		samples;	///< number of samples taken
+};
+
+
+/** \brief Wait until the specified signal is stable
+*
+* The signal is sampled about every \p interval seconds, rounded up to
+* whole milliseconds of sleep. Once \p window samples
+* are available, a straight line is fitted to them. The signal is considered
+* settled when the standard deviation around the mean and the change of the
+* fitted line across the window are both below \p tolerance.
+*
+* \param input Signal to monitor.
+* \param tolerance Allowed scatter and drift, in the units of the signal.
+* \param maxSecs Timeout. The wait never takes (much) longer than this,
+* so it can directly replace a fixed Sleep() of the same length.
+* \param window Number of samples in the sliding window (at least 3).
+* \param interval Time between samples in seconds.
+* \param soft Read the signal in soft (\c TRUE) or hard units.
+*
+* \return Settle time, final value and statistics. \c settled is \c FALSE
+* if the timeout expired first.
+*/
+inline LithoSettleResult LithoWaitSettled(LithoSignal input, double tolerance, double maxSecs,
+										  int window = 16, double interval = 0.002, bool soft = true)
+{
+	if (window < 3)
+		window = 3;
+
+	std::vector<double> t(window), y(window);
+	LithoSettleResult r;
+	r.settled = false;
+	r.samples = 0;
+	r.value = r.stddev = r.drift = 0;
+
+	double start = LithoNow();
+	double next = start;
+	for (;;)
+	{
+		double now = LithoNow();
+		int slot = r.samples % window;
+		t[slot] = now - start;
+		y[slot] = soft ? LithoGetSoft(input) : LithoGet(input);
+		r.samples++;
+		r.value = y[slot];
+
+		if (r.samples >= window)
+		{
+			// least squares line through the window
+			double st = 0, sy = 0;
+			for (int i=0; i<window; i++)
+			{
+				st += t[i];
+				sy += y[i];
+			}
+			double mt = st / window, my = sy / window;
+			double stt = 0, sty = 0, syy = 0;
+			for (int i=0; i<window; i++)
+			{
+				double dt = t[i] - mt, dy = y[i] - my;
+				stt += dt * dt;
+				sty += dt * dy;
+				syy += dy * dy;
+			}
+			double span = t[slot] - t[(slot + 1) % window];
+			r.value = my;
+			r.stddev = sqrt(syy / (window - 1));
+			r.drift = stt > 0 ? fabs(sty / stt * span) : 0;
+			if (r.stddev <= tolerance && r.drift <= tolerance)
+			{
+				r.settled = true;
+				break;
+			}
+		}
+
+		if (now - start >= maxSecs)
+			break;
+		next += interval;
+		if (next - start > maxSecs)
+			next = start + maxSecs;
+		double left = next - LithoNow();
+		if (left > 0)
+			LithoWaitUntil(LithoNow() + ceil(1000 * left) / 1000, 0);	// whole milliseconds, no spinning
+	}
+	r.secs = LithoNow() - start;
+	return r;
+}
+
+#endif // __NANOSCRIPT_SETTLE_H__
@@ -0,0 +1,236 @@
+/** \file NanoScript_SIGNALS.h
+*	\brief Compile-time signal metadata and unit checked Litho calls
+*
+*	The I/O direction and the unit of every LithoSignal are only given in
+*	the comments of NanoScript_Litho.h. This file puts them in a constexpr
+*	table, so that typed wrappers can check them while compiling:
+*
+*	\li LithoSetAs / LithoPulseAs refuse signals that are not outputs and
+*	quantities whose unit does not match the signal.
+*	\li LithoReadAs refuses signals that are outputs.
+*	\li Values set or pulsed go through the session limits (NanoScript_LIMITS.h).
+*	\li Quantities are converted to the unit of the signal with a
+*	compile-time constant factor, e.g. Volts for lsBias (mV) become a
+*	multiplication by 1000.
+*
+*	example:
+*
+*	LithoPulseAs<lsBias>(Volts(8), 0.1);		// LithoPulse(lsBias, 8000, 0.1)
+*	LithoSetAs<lsBias>(Degrees(8));				// error: unit mismatch
+*	LithoReadAs<lsNS5FPOutput1>();				// error: signal is an output
+*
+*	The NS5 front panel outputs are outputs, but our setups route the lock-in
+*	amplitude and phase to them, and the macros read them back. Such reads
+*	must name the routing explicitly through a LithoChannel, which also
+*	carries the scale from volts to the physical quantity:
+*
+*	double amp = LithoReadChannel<PfmAmplitude>().value;	// 1000 * LithoGetSoft(lsNS5FPOutput1)
+*	double pha = LithoReadChannel<PfmPhase>().value;		// 180/10 * LithoGetSoft(lsNS5FPOutput2)
+*	double sim = LithoReadChannel<PfmPhase>(inst).value;	// the same through inst.GetSoft, any instrument
+*/
+
+#ifndef __NANOSCRIPT_SIGNALS_H__
+#define __NANOSCRIPT_SIGNALS_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include "NanoScript_LIMITS.h"
+
+
+/// I/O direction of a signal
+enum LithoDirection
+{
+	ldOutput,		///< can be set
+	ldInput,		///< can be read
+	ldInternal		///< internal parameter, can be set and read
+};
+
+
+/// Unit of a signal or a quantity
+enum LithoUnit
+{
+	luVolt,
+	luMillivolt,
+	luNanometer,
+	luNanoamp,
+	luKilohertz,
+	luDegree,
+	luDimensionless,
+	luVoltOrNanometer,	///< V in open loop, nm in closed loop
+	luVoltOrNanoamp		///< V in AFM modes, nA in STM mode
+};
+
+
+/// Metadata of one signal
+struct LithoSignalInfo
+{
+	LithoSignal		signal;
+	LithoDirection	direction;
+	LithoUnit		unit;
+	const char*		name;
+};
+
+
+/// Metadata of all signals, indexed by LithoSignal
+constexpr LithoSignalInfo lithoSignalTable[lsCount] =
+{
+	{ lsX,					ldOutput,	luVoltOrNanometer,	"X drive" },
+	{ lsY,					ldOutput,	luVoltOrNanometer,	"Y drive" },
+	{ lsZ,					ldOutput,	luVoltOrNanometer,	"relative Z drive" },
+	{ lsZlimit,				ldOutput,	luVoltOrNanometer,	"Z MDAC" },
+	{ lsBias,				ldOutput,	luMillivolt,		"sample bias" },
+	{ lsSetpoint,			ldOutput,	luVoltOrNanoamp,	"setpoint" },
+	{ lsAna1,				ldOutput,	luVolt,				"Analog 1" },
+	{ lsAna2,				ldOutput,	luVolt,				"tip bias (DDS2)" },
+	{ lsAna2HV,				ldOutput,	luVolt,				"tip bias (DDS2) HV" },
+	{ lsAna3,				ldOutput,	luVolt,				"Analog 3" },
+	{ lsAna4,				ldOutput,	luVolt,				"Analog 4" },
+	{ lsIn0,				ldInput,	luVolt,				"Input 0 (LSADC1)" },
+	{ lsIn1,				ldInput,	luVolt,				"Input 1" },
+	{ lsIn2,				ldInput,	luVolt,				"Input 2" },
+	{ lsIn3,				ldInput,	luVolt,				"Input 3" },
+	{ lsIn4,				ldInput,	luVolt,				"Input 4" },
+	{ lsAuxA,				ldInput,	luVolt,				"AuxA" },
+	{ lsAuxB,				ldInput,	luVolt,				"X sensor" },
+	{ lsAuxC,				ldInput,	luVolt,				"Y sensor" },
+	{ lsAuxD,				ldInput,	luVolt,				"Z sensor" },
+	{ lsZsweep,				ldInternal,	luNanometer,		"Z sweep" },
+	{ lsDriveFreq,			ldInternal,	luKilohertz,		"drive frequency" },
+	{ lsDriveAmpl,			ldInternal,	luMillivolt,		"drive amplitude" },
+	{ lsDrivePhase,			ldInternal,	luDegree,			"drive phase" },
+	{ lsIntegralGain,		ldInternal,	luDimensionless,	"integral gain" },
+	{ lsProportionalGain,	ldInternal,	luDimensionless,	"proportional gain" },
+	{ lsECBias,				ldInternal,	luVolt,				"EC bias" },
+	{ lsNS5FPInput1,		ldInput,	luVolt,				"NS5 front panel input 1" },
+	{ lsNS5FPInput2,		ldInput,	luVolt,				"NS5 front panel input 2" },
+	{ lsNS5FPOutput1,		ldOutput,	luVolt,				"NS5 front panel output 1" },
+	{ lsNS5FPOutput2,		ldOutput,	luVolt,				"NS5 front panel output 2" }
+};
+
+
+/// Metadata of a signal
+constexpr const LithoSignalInfo& LithoInfo(LithoSignal s)
+{
+	return lithoSignalTable[s];
+}
+
+
+// the table must stay in the order of the enum
+constexpr bool LithoSignalTableOrdered(int i = 0)
+{
+	return i == lsCount || (lithoSignalTable[i].signal == i && LithoSignalTableOrdered(i + 1));
+}
+static_assert(LithoSignalTableOrdered(), "lithoSignalTable is out of order with LithoSignal");
+
+
+/** \brief Factor converting a value in unit \p from to the unit \p to
+*
+* \return The factor, or 0 if the units cannot be converted.
+*/
+constexpr double LithoUnitScale(LithoUnit from, LithoUnit to)
+{
+	return from == to ? 1.0
+		: from == luVolt && to == luMillivolt ? 1000.0
+		: from == luMillivolt && to == luVolt ? 0.001
+		: (from == luVolt || from == luNanometer) && to == luVoltOrNanometer ? 1.0
+		: (from == luVolt || from == luNanoamp) && to == luVoltOrNanoamp ? 1.0
+		: 0.0;
+}
+
+
+/// A value tagged with its unit
+template <LithoUnit U>
+struct LithoQuantity
+{
+	static const LithoUnit unit = U;
+	double value;
+	constexpr explicit LithoQuantity(double v) : value(v) {}
+};
+
+typedef LithoQuantity<luVolt>			Volts;
+typedef LithoQuantity<luMillivolt>		Millivolts;
+typedef LithoQuantity<luNanometer>		Nanometers;
+typedef LithoQuantity<luNanoamp>		Nanoamps;
+typedef LithoQuantity<luKilohertz>		Kilohertz;
+typedef LithoQuantity<luDegree>			Degrees;
+typedef LithoQuantity<luDimensionless>	Dimensionless;
+
+
+/// Set an output in soft units, from a quantity of a compatible unit, within the session limits
+template <LithoSignal S, LithoUnit U>
+inline bool LithoSetAs(LithoQuantity<U> q)
+{
+	static_assert(LithoInfo(S).direction != ldInput, "LithoSetAs: signal is an input");
+	static_assert(LithoUnitScale(U, LithoInfo(S).unit) != 0, "LithoSetAs: unit does not match the signal");
+	return LithoSetSoftLimited(S, LithoUnitScale(U, LithoInfo(S).unit) * q.value);
+}
+
+
+/// Pulse an output, the amplitude is given as a quantity of a compatible unit, within the session limits
+template <LithoSignal S, LithoUnit U>
+inline bool LithoPulseAs(LithoQuantity<U> q, double secs)
+{
+	static_assert(LithoInfo(S).direction != ldInput, "LithoPulseAs: signal is an input");
+	static_assert(LithoUnitScale(U, LithoInfo(S).unit) != 0, "LithoPulseAs: unit does not match the signal");
+	double v = LithoUnitScale(U, LithoInfo(S).unit) * q.value;
+	return LithoLimits().CheckPulse(S, v, true) && LithoPulse(S, v, secs);
+}
+
+
+/// Read an input in soft units, converted to the requested unit
+template <LithoSignal S, LithoUnit U>
+inline LithoQuantity<U> LithoReadAs()
+{
+	static_assert(LithoInfo(S).direction != ldOutput, "LithoReadAs: signal is an output, read it through a LithoChannel");
+	static_assert(LithoUnitScale(LithoInfo(S).unit, U) != 0, "LithoReadAs: unit does not match the signal");
+	return LithoQuantity<U>(LithoUnitScale(LithoInfo(S).unit, U) * LithoGetSoft(S));
+}
+
+
+/// Read an input in soft units, in the unit of the signal
+template <LithoSignal S>
+inline LithoQuantity<LithoInfo(S).unit> LithoReadAs()
+{
+	return LithoReadAs<S, LithoInfo(S).unit>();
+}
+
+
+/** \brief A measured quantity routed to a signal
+*
+* The signal carries the quantity as a voltage; the quantity is
+* Num / Den times that voltage, in unit U.
+*/
+template <LithoSignal S, LithoUnit U, int Num, int Den = 1>
+struct LithoChannel
+{
+	static const LithoSignal signal = S;
+	static const LithoUnit unit = U;
+	static constexpr double scale = (double)Num / Den;
+};
+
+/// Lock-in amplitude on front panel output 1, 1 V = 1000 mV
+typedef LithoChannel<lsNS5FPOutput1, luMillivolt, 1000>	PfmAmplitude;
+/// Lock-in phase on front panel output 2, 10 V = 180 degrees
+typedef LithoChannel<lsNS5FPOutput2, luDegree, 180, 10>	PfmPhase;
+
+
+/// Read a measured quantity through its channel
+template <class Channel>
+inline LithoQuantity<Channel::unit> LithoReadChannel()
+{
+	static_assert(LithoInfo(Channel::signal).unit == luVolt, "LithoReadChannel: channel signal must be in volts");
+	return LithoQuantity<Channel::unit>(Channel::scale * LithoGetSoft(Channel::signal));
+}
+
+/// Read a measured quantity through its channel on any instrument with GetSoft (NanoScript_INSTRUMENT.h)
+template <class Channel, class Instrument>
+inline LithoQuantity<Channel::unit> LithoReadChannel(Instrument& inst)
+{
+	static_assert(LithoInfo(Channel::signal).unit == luVolt, "LithoReadChannel: channel signal must be in volts");
+	return LithoQuantity<Channel::unit>(Channel::scale * inst.GetSoft(Channel::signal));
+}
+
+#endif // __NANOSCRIPT_SIGNALS_H__
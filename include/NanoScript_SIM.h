@@ -0,0 +1,250 @@
+/** \file NanoScript_SIM.h
+*	\brief Simulated instrument for trying out measurement plans off-line
+*
+*	SimInstrument has the same members as LithoHardware
+*	(NanoScript_INSTRUMENT.h), but drives a model of a ferroelectric sample
+*	seen through the lock-in outputs instead of the microscope. Time is
+*	virtual: Pause and Pulse advance the model clock without sleeping, so a
+*	sweep that takes minutes on the microscope runs in microseconds.
+*
+*	Every instance owns its model state and random generator. There is no
+*	global state, so any number of instances can run in parallel threads.
+*
+*	Signals as the macros use them:
+*	\li lsBias - sample bias in mV (LithoSet / LithoPulse)
+*	\li lsNS5FPOutput1 - set: DC tip bias in V. read: PFM amplitude in V
+*	\li lsNS5FPOutput2 - read: PFM phase, 10 V = 180 degrees (srPfm), or the
+*	electrostatic response, proportional to bias minus contact potential (srKpfm)
+*
+*	The sample is a set of hysterons (Preisach model) with normally
+*	distributed coercive voltages. The coercive voltage grows for shorter
+*	pulses. The lock-in outputs follow the sample through a first order lag,
+*	with Gaussian noise and occasional spurious zeros.
+*/
+
+#ifndef __NANOSCRIPT_SIM_H__
+#define __NANOSCRIPT_SIM_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include <math.h>
+#include <random>
+#include <vector>
+
+
+/// What lsNS5FPOutput2 is wired to
+enum SimReadout
+{
+	srPfm,		///< lock-in phase, 10 V = 180 degrees
+	srKpfm		///< electrostatic response, zero at the contact potential
+};
+
+
+/// Parameters of the simulated sample and instrument
+struct SimModel
+{
+	SimReadout	readout;
+	double	coercive;				///< mean coercive voltage for a 0.1 s pulse (V)
+	double	coerciveSpread;			///< standard deviation of the hysteron coercive voltages (V)
+	double	imprint;				///< shift of the loop along the voltage axis (V)
+	double	durationExponent;		///< coercive voltage scales as (pulse / 0.1 s) ^ -durationExponent
+	double	amplitude;				///< PFM amplitude of a fully poled area at lsNS5FPOutput1 (V)
+	double	electrostatic;			///< on-field electrostatic contribution to the PFM signal (V per V)
+	double	phaseOffset;			///< lock-in phase of an up-poled area (degrees)
+	double	kpfmGain;				///< srKpfm response per volt of bias minus contact potential
+	double	surfacePotential;		///< contact potential of an unpoled area (V)
+	double	potentialPerPolarization;	///< change of the contact potential for a fully poled area (V)
+	double	drift;					///< drift of the contact potential (V/s)
+	double	lockinTau;				///< lock-in time constant (s)
+	double	noise;					///< rms noise of each lock-in quadrature (V)
+	double	glitchRate;				///< probability that a read of an NS5 output returns exactly 0
+	double	callTime;				///< time taken by one Set/Get call (s)
+	int		hysterons;				///< number of hysterons in the Preisach model
+	unsigned	seed;				///< seed of the noise generator
+
+	SimModel() :
+		readout(srPfm), coercive(3.0), coerciveSpread(0.6), imprint(0.3), durationExponent(0.08),
+		amplitude(0.05), electrostatic(0.002), phaseOffset(90), kpfmGain(0.1), surfacePotential(0.25),
+		potentialPerPolarization(0.15), drift(0), lockinTau(0.01), noise(0.001), glitchRate(0),
+		callTime(0.001), hysterons(200), seed(1)
+	{}
+};
+
+
+/// Simulated instrument, see the file description
+class SimInstrument
+{
+public:
+	explicit SimInstrument(const SimModel& m = SimModel()) :
+		model(m), rng(m.seed), gauss(0, 1), uniform(0, 1), now(0), x(0), y(0), kpfm(0)
+	{
+		for (int i=0; i<lsCount; i++)
+			outputs[i] = 0;
+		state.assign(model.hysterons > 0 ? model.hysterons : 1, -1);
+		thresholds.resize(state.size());
+		for (size_t i=0; i<thresholds.size(); i++)
+			thresholds[i] = fabs(model.coercive + model.coerciveSpread * gauss(rng));
+		// start from a virgin, randomly poled sample
+		for (size_t i=0; i<state.size(); i++)
+			state[i] = uniform(rng) < 0.5 ? -1 : 1;
+		x = Target();
+	}
+
+	const SimModel& Model() const { return model; }
+
+	/// Model time in seconds
+	double Now() const { return now; }
+
+	/// Net polarization, -1 (down) to +1 (up)
+	double Polarization() const
+	{
+		double p = 0;
+		for (size_t i=0; i<state.size(); i++)
+			p += state[i];
+		return p / state.size();
+	}
+
+	/// Contact potential at the present time (V)
+	double ContactPotential() const
+	{
+		return model.surfacePotential + model.potentialPerPolarization * Polarization() + model.drift * now;
+	}
+
+	/// Coercive voltages (up, down) of the loop for pulses of the given width
+	void CoerciveVoltages(double pulseSecs, double& up, double& down) const
+	{
+		double scale = DurationScale(pulseSecs);
+		up = model.imprint + model.coercive * scale;
+		down = model.imprint - model.coercive * scale;
+	}
+
+	bool Set(LithoSignal output, double v)
+	{
+		Advance(model.callTime);
+		outputs[output] = v;
+		Switch(1.0);
+		return true;
+	}
+
+	bool SetSoft(LithoSignal output, double v) { return Set(output, v); }
+
+	double Get(LithoSignal input)
+	{
+		Advance(model.callTime);
+		if (input == lsNS5FPOutput1 || input == lsNS5FPOutput2)
+		{
+			if (model.glitchRate > 0 && uniform(rng) < model.glitchRate)
+				return 0;
+			if (input == lsNS5FPOutput2 && model.readout == srKpfm)
+				return kpfm + model.noise * gauss(rng);
+			double nx = x + model.noise * gauss(rng);
+			double ny = y + model.noise * gauss(rng);
+			if (input == lsNS5FPOutput1)
+				return sqrt(nx * nx + ny * ny);
+			double phase = model.phaseOffset + atan2(ny, nx) * 180 / 3.14159265358979;
+			while (phase > 180) phase -= 360;
+			while (phase <= -180) phase += 360;
+			return phase / 18;
+		}
+		if (input >= 0 && input < lsCount)
+			return outputs[input] + model.noise * gauss(rng);
+		return 0;
+	}
+
+	double GetSoft(LithoSignal input) { return Get(input); }
+
+	bool Pulse(LithoSignal output, double v, double secs)
+	{
+		double before = outputs[output];
+		Advance(model.callTime);
+		outputs[output] = v;
+		Switch(secs);
+		Advance(secs);
+		outputs[output] = before;
+		return true;
+	}
+
+	bool Ramp(LithoSignal output, double startValue, double endValue, double secs)
+	{
+		const int steps = 100;
+		for (int i=0; i<=steps; i++)
+		{
+			outputs[output] = startValue + (endValue - startValue) * i / steps;
+			Switch(secs / steps);
+			Advance(secs / steps);
+		}
+		return true;
+	}
+
+	bool Trigger(TriggerLine) { return true; }
+
+	void Pause(double secs) { Advance(secs); }
+
+	/// Tip motion takes its time; the sample does not move
+	bool Translate(double dxUm, double dyUm, double rateUmPerSec)
+	{
+		Advance(model.callTime);
+		if (rateUmPerSec > 0)
+			Advance(sqrt(dxUm * dxUm + dyUm * dyUm) / rateUmPerSec);
+		return true;
+	}
+
+private:
+	/// Tip-sample voltage in volts
+	double Applied() const { return outputs[lsBias] / 1000 + outputs[lsNS5FPOutput1]; }
+
+	double DurationScale(double secs) const
+	{
+		if (secs < 1e-6)
+			secs = 1e-6;
+		return pow(secs / 0.1, -model.durationExponent);
+	}
+
+	/// Hysterons switch when the applied voltage, held for secs, exceeds their coercive voltage
+	void Switch(double secs)
+	{
+		double v = Applied() - model.imprint;
+		double scale = DurationScale(secs);
+		for (size_t i=0; i<state.size(); i++)
+		{
+			double c = thresholds[i] * scale;
+			if (v > c)
+				state[i] = 1;
+			else if (v < -c)
+				state[i] = -1;
+		}
+	}
+
+	/// In-phase lock-in signal the outputs are heading for
+	double Target() const
+	{
+		return model.amplitude * Polarization() + model.electrostatic * (Applied() - ContactPotential());
+	}
+
+	/// Advance model time, the lock-in outputs relax towards their targets
+	void Advance(double secs)
+	{
+		if (secs <= 0)
+			return;
+		double k = model.lockinTau > 0 ? 1 - exp(-secs / model.lockinTau) : 1;
+		x += (Target() - x) * k;
+		y += (0 - y) * k;
+		kpfm += (model.kpfmGain * (Applied() - ContactPotential()) - kpfm) * k;
+		now += secs;
+	}
+
+	SimModel model;
+	std::mt19937 rng;
+	std::normal_distribution<double> gauss;
+	std::uniform_real_distribution<double> uniform;
+	double outputs[lsCount];
+	std::vector<int> state;
+	std::vector<double> thresholds;
+	double now;
+	double x, y, kpfm;
+};
+
+#endif // __NANOSCRIPT_SIM_H__
@@ -0,0 +1,169 @@
+/** \file NanoScript_SSPFM.h
+*	\brief Switching spectroscopy PFM (SS-PFM) with on-field and off-field readout
+*
+*	Pulsing and then probing at a read voltage costs a pulse call, a set
+*	call and a wait at every step, and only gives the remanent (off-field)
+*	loop. SS-PFM applies one stepped triangular waveform instead: the DC
+*	field steps 0 -> +vMax -> -vMax -> 0, and every step is followed by a
+*	segment at the read field. Amplitude and phase are read in both
+*	segments and averaged as a vector, so one pass gives the on-field loop
+*	(electrostatic contribution included) and the off-field loop side by
+*	side. The API has no block read: every read is a pair of GetSoft calls.
+*
+*	The segments run on one clock from the start of the waveform, waited
+*	for with the instrument's Pause, so call times do not add up over the
+*	waveform (as NanoScript_TRAIN.h). The first reads of a segment wait
+*	for the lock-in (\c settle); the rest of the segment is read.
+*
+*	example:
+*
+*	SspfmParams p;									// +-8 V, 20 steps per quarter
+*	std::vector<double> fields;
+*	SspfmBuildWaveform(p, fields);
+*	std::vector<SspfmPoint> loop;
+*	LithoHardware afm;
+*	RunSspfm(afm, p, fields, loop);
+*	// loop[i].on and loop[i].off: vector averages at fields[i]
+*/
+
+#ifndef __NANOSCRIPT_SSPFM_H__
+#define __NANOSCRIPT_SSPFM_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include "NanoScript_PHASE.h"
+#include "NanoScript_SIGNALS.h"
+#include <vector>
+
+
+/// Parameters of an SS-PFM waveform
+struct SspfmParams
+{
+	double	vMax;				///< top of the triangle (V)
+	int		steps;				///< steps from 0 to vMax; the waveform has 4 steps + 1 on-field segments per cycle
+	int		cycles;				///< triangles run back to back
+	double	vRead;				///< field of the off-field segments (V)
+	double	onSecs;				///< length of an on-field segment (s)
+	double	offSecs;			///< length of an off-field segment (s)
+	double	settle;				///< wait at the start of each segment before the reads (s)
+	int		reads;				///< read pairs per segment, at most LITHO_VECTOR_BLOCK
+
+	SspfmParams() : vMax(8), steps(20), cycles(1), vRead(0), onSecs(0.05), offSecs(0.05), settle(0.02), reads(8) {}
+};
+
+
+/// Readout of one step of the waveform
+struct SspfmPoint
+{
+	double	field;				///< field of the on-field segment (V)
+	LithoVectorAverage	on;		///< response during the step
+	LithoVectorAverage	off;	///< response at vRead after the step
+	double	late;				///< how late the step started, seconds
+};
+
+
+/** \brief Fields of the on-field segments
+*
+* 0, +step ... +vMax ... -vMax ... 0 for every cycle; the 0 between two
+* cycles is not repeated.
+*/
+inline void SspfmBuildWaveform(const SspfmParams& p, std::vector<double>& fields)
+{
+	fields.clear();
+	int n = p.steps > 0 ? p.steps : 1;
+	double dv = p.vMax / n;
+	fields.push_back(0);
+	for (int c=0; c<p.cycles; c++)
+	{
+		for (int i=1; i<=n; i++)
+			fields.push_back(i * dv);
+		for (int i=n-1; i>=-n; i--)
+			fields.push_back(i * dv);
+		for (int i=-n+1; i<=0; i++)
+			fields.push_back(i * dv);
+	}
+}
+
+
+/// Read a segment's block of amplitude and phase through PfmAmplitude and PfmPhase (NanoScript_SIGNALS.h)
+template <class Instrument>
+LithoVectorAverage SspfmReadBlock(Instrument& inst, int reads)
+{
+	double r[LITHO_VECTOR_BLOCK], theta[LITHO_VECTOR_BLOCK];
+	if (reads < 1)
+		reads = 1;
+	if (reads > LITHO_VECTOR_BLOCK)
+		reads = LITHO_VECTOR_BLOCK;
+	for (int i=0; i<reads; i++)
+	{
+		r[i] = LithoReadChannel<PfmAmplitude>(inst).value;
+		theta[i] = LithoReadChannel<PfmPhase>(inst).value;
+	}
+	LithoVectorMean mean;
+	mean.AddPolar(r, theta, reads);
+	return mean.Result();
+}
+
+
+/// Set the bias back to vRead, or to 0 if that is refused. \return \c FALSE if both were refused.
+template <class Instrument>
+bool SspfmRestore(Instrument& inst, const SspfmParams& p)
+{
+	return inst.Set(lsBias, 1000 * p.vRead) || inst.Set(lsBias, 0);
+}
+
+
+/** \brief Run the waveform on lsBias and read both segments of every step
+*
+* The bias is held at each field (Set, hard units) rather than pulsed, and
+* left at vRead.
+*
+* \param points Receives one point per step completed.
+* \return \c FALSE if a set was refused (e.g. by the session limits); the
+* bias is set back to vRead, or to 0 if vRead is refused, before returning.
+*/
+template <class Instrument>
+bool RunSspfm(Instrument& inst, const SspfmParams& p, const std::vector<double>& fields, std::vector<SspfmPoint>& points)
+{
+	points.clear();
+	points.reserve(fields.size());
+	double start = inst.Now();
+	double period = p.onSecs + p.offSecs;
+	for (size_t i=0; i<fields.size(); i++)
+	{
+		SspfmPoint pt;
+		pt.field = fields[i];
+		double at = start + i * period;
+		if (at > inst.Now())
+			inst.Pause(at - inst.Now());
+		pt.late = inst.Now() - at;
+		if (!inst.Set(lsBias, 1000 * fields[i]))
+		{
+			SspfmRestore(inst, p);
+			return false;
+		}
+		inst.Pause(p.settle);
+		pt.on = SspfmReadBlock(inst, p.reads);
+
+		at += p.onSecs;
+		if (at > inst.Now())
+			inst.Pause(at - inst.Now());
+		if (!inst.Set(lsBias, 1000 * p.vRead))
+		{
+			inst.Set(lsBias, 0);			// not left on-field
+			return false;
+		}
+		inst.Pause(p.settle);
+		pt.off = SspfmReadBlock(inst, p.reads);
+		points.push_back(pt);
+	}
+	double end = start + fields.size() * period;
+	if (end > inst.Now())
+		inst.Pause(end - inst.Now());
+	return true;
+}
+
+#endif // __NANOSCRIPT_SSPFM_H__
@@ -0,0 +1,272 @@
+/** \file NanoScript_STUDY.h
+*	\brief Pulse-and-read hysteresis loops and parallel parameter studies
+*
+*	RunPfmLoop is the sweep of Piezoreponse.cpp (pulse lsBias, wait, average
+*	amplitude and phase as a vector) written as a template over the
+*	instrument, so the same plan runs on the microscope (LithoHardware) and
+*	on SimInstrument.
+*
+*	RunParameterStudy runs the plan on independent simulated instruments for
+*	every point of a parameter grid, with several noise seeds per point,
+*	spread over all cores, and aggregates loop quality metrics.
+*/
+
+#ifndef __NANOSCRIPT_STUDY_H__
+#define __NANOSCRIPT_STUDY_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_SIM.h"
+#include "NanoScript_PHASE.h"
+#include "NanoScript_SIGNALS.h"
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+/// Parameters of a Piezoreponse.cpp style loop
+struct PfmLoopParams
+{
+	double	V_max;				///< maximum pulse voltage (V)
+	double	V_step;				///< voltage step (V)
+	double	pulse_dura;			///< pulse width (s)
+	double	post_pulse_time;	///< wait between pulse and reads (s)
+	int		reads;				///< amplitude and phase read pairs averaged as a vector, at least 2
+	int		cycles;				///< full loops +V_max -> -V_max -> +V_max after the initial 0 -> +V_max branch
+
+	PfmLoopParams() : V_max(8), V_step(0.05), pulse_dura(0.1), post_pulse_time(0.3), reads(3), cycles(1) {}
+};
+
+
+/// One point of a loop, as written to A_zhiyong.txt
+struct PfmLoopPoint
+{
+	double	volt;	///< pulse voltage (V)
+	double	pha;	///< phase of the mean vector (degrees, -180 .. 180)
+	double	amp;	///< amplitude of the mean vector (mV)
+	int		dir;	///< +1 on the up branch, -1 on the down branch, 0 on the initial branch
+};
+
+
+/** \brief Run a pulse-and-read loop
+*
+* Follows the stepping of Piezoreponse.cpp: the voltage moves by V_step,
+* reverses direction when it passes V_max and is not pulsed on the
+* reversal step. The initial branch from 0 V (virgin curve) is
+* followed by the requested number of full loops.
+*/
+template <class Instrument>
+void RunPfmLoop(Instrument& inst, const PfmLoopParams& p, std::vector<PfmLoopPoint>& points)
+{
+	points.clear();
+	double flag = 1;
+	double Volt_now = 0;
+	bool virgin = true;
+	int quarter = (int)(p.V_max / p.V_step + 0.5);
+	int steps = quarter * (1 + 4 * p.cycles);
+	for (int i=0; i<steps; )
+	{
+		if (fabs(Volt_now) > p.V_max)
+		{
+			flag = -flag;
+			Volt_now += p.V_step * flag;
+			virgin = false;
+			continue;
+		}
+		Volt_now += p.V_step * flag;
+		inst.Pulse(lsBias, 1000 * Volt_now, p.pulse_dura);
+		inst.Pause(p.post_pulse_time);
+		PfmLoopPoint pt;
+		pt.volt = Volt_now;
+		pt.dir = virgin ? 0 : flag > 0 ? 1 : -1;
+		// a fixed number of reads: no targets, minReads = maxReads
+		LithoVectorAverage v = LithoVectorAverageUntil(
+			[&]{ return LithoReadChannel<PfmAmplitude>(inst).value; },
+			[&]{ return LithoReadChannel<PfmPhase>(inst).value; },
+			0, 0, p.reads, p.reads, p.reads);
+		pt.amp = v.amplitude;
+		pt.pha = v.phase;
+		points.push_back(pt);
+		i++;
+	}
+}
+
+
+/// Quality of one loop
+struct PfmLoopMetrics
+{
+	double	vcUp;		///< coercive voltage on the up branch (V)
+	double	vcDown;		///< coercive voltage on the down branch (V)
+	double	vcError;	///< rms deviation of the coercive voltages from the model's (V)
+	double	remanence;	///< mean |response| at zero voltage (mV)
+	double	noise;		///< white noise estimate of the response (mV)
+	double	secs;		///< duration of the loop on the model clock (s)
+	int		points;		///< number of points in the loop
+};
+
+
+/// Amplitude signed by the phase: positive for up-poled, negative for down-poled areas
+inline double PfmLoopSigned(const PfmLoopPoint& pt, double phaseOffset)
+{
+	return pt.amp * cos((pt.pha - phaseOffset) * 3.14159265358979 / 180);
+}
+
+
+/// Median of the voltages where the signed response changes sign in the given direction
+inline double PfmLoopCrossing(const std::vector<PfmLoopPoint>& pts, int dir, double phaseOffset)
+{
+	std::vector<double> v;
+	for (size_t i=1; i<pts.size(); i++)
+	{
+		if (pts[i].dir != dir || pts[i - 1].dir != dir)
+			continue;
+		double s0 = PfmLoopSigned(pts[i - 1], phaseOffset);
+		double s1 = PfmLoopSigned(pts[i], phaseOffset);
+		if ((dir > 0 && s0 < 0 && s1 >= 0) || (dir < 0 && s0 > 0 && s1 <= 0))
+			v.push_back(pts[i - 1].volt + (pts[i].volt - pts[i - 1].volt) * s0 / (s0 - s1));
+	}
+	if (v.empty())
+		return 0;
+	std::sort(v.begin(), v.end());
+	return v[v.size() / 2];
+}
+
+
+/// Metrics of a loop measured on a simulated instrument
+inline PfmLoopMetrics PfmLoopEvaluate(const SimInstrument& inst, const PfmLoopParams& p,
+									  const std::vector<PfmLoopPoint>& pts, double secs)
+{
+	PfmLoopMetrics m;
+	m.points = (int)pts.size();
+	m.secs = secs;
+	double offset = inst.Model().phaseOffset;
+	m.vcUp = PfmLoopCrossing(pts, 1, offset);
+	m.vcDown = PfmLoopCrossing(pts, -1, offset);
+	double up, down;
+	inst.CoerciveVoltages(p.pulse_dura, up, down);
+	m.vcError = sqrt(0.5 * ((m.vcUp - up) * (m.vcUp - up) + (m.vcDown - down) * (m.vcDown - down)));
+
+	double rem = 0, d2 = 0;
+	int nrem = 0, nd2 = 0;
+	for (size_t i=0; i<pts.size(); i++)
+	{
+		double s = PfmLoopSigned(pts[i], offset);
+		if (fabs(pts[i].volt) < 0.5 * p.V_step + 1e-9)
+		{
+			rem += fabs(s);
+			nrem++;
+		}
+		if (i >= 2 && pts[i].dir == pts[i - 2].dir)
+		{
+			double dd = s - 2 * PfmLoopSigned(pts[i - 1], offset) + PfmLoopSigned(pts[i - 2], offset);
+			d2 += dd * dd;
+			nd2++;
+		}
+	}
+	m.remanence = nrem ? rem / nrem : 0;
+	// second differences of white noise have variance 6 sigma^2
+	m.noise = nd2 ? sqrt(d2 / nd2 / 6) : 0;
+	return m;
+}
+
+
+/** \brief Run f(0) ... f(n-1) on a pool of threads
+*
+* \param threads Number of worker threads, 0 for one per core.
+*/
+template <class F>
+void ParallelFor(int n, int threads, F f)
+{
+	if (threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+	if (threads <= 0)
+		threads = 1;
+	if (threads > n)
+		threads = n;
+	std::atomic<int> next(0);
+	std::vector<std::thread> pool;
+	for (int t=0; t<threads; t++)
+		pool.push_back(std::thread([&]() {
+			for (int i = next++; i < n; i = next++)
+				f(i);
+		}));
+	for (size_t t=0; t<pool.size(); t++)
+		pool[t].join();
+}
+
+
+/// Mean and standard deviation of a metric over the repeats of a grid point
+struct StudyStat
+{
+	double mean, stddev;
+	StudyStat() : mean(0), stddev(0) {}
+};
+
+
+/// Aggregated result of one grid point
+struct StudyResult
+{
+	PfmLoopParams	params;
+	StudyStat		vcError, remanence, noise, secs;
+	int				repeats;
+};
+
+
+/** \brief Run the loop plan over a parameter grid on simulated instruments
+*
+* Every (grid point, repeat) pair gets its own SimInstrument, seeded with
+* model.seed + repeat, so results are reproducible and independent of the
+* number of threads.
+*
+* \param grid Loop parameters to try.
+* \param model Sample and instrument model.
+* \param repeats Noise realizations per grid point.
+* \param threads Worker threads, 0 for one per core.
+* \param results One entry per grid point, in grid order.
+*/
+inline void RunParameterStudy(const std::vector<PfmLoopParams>& grid, const SimModel& model, int repeats,
+							  int threads, std::vector<StudyResult>& results)
+{
+	if (repeats < 1)
+		repeats = 1;
+	int n = (int)grid.size() * repeats;
+	std::vector<PfmLoopMetrics> runs(n);
+	ParallelFor(n, threads, [&](int i) {
+		const PfmLoopParams& p = grid[i / repeats];
+		SimModel m = model;
+		m.seed = model.seed + i % repeats;
+		SimInstrument inst(m);
+		std::vector<PfmLoopPoint> pts;
+		double t0 = inst.Now();
+		RunPfmLoop(inst, p, pts);
+		runs[i] = PfmLoopEvaluate(inst, p, pts, inst.Now() - t0);
+	});
+
+	results.resize(grid.size());
+	for (size_t g=0; g<grid.size(); g++)
+	{
+		StudyResult& r = results[g];
+		r.params = grid[g];
+		r.repeats = repeats;
+		StudyStat* stats[4] = { &r.vcError, &r.remanence, &r.noise, &r.secs };
+		for (int k=0; k<4; k++)
+		{
+			double s = 0, ss = 0;
+			for (int j=0; j<repeats; j++)
+			{
+				const PfmLoopMetrics& m = runs[g * repeats + j];
+				double v = k == 0 ? m.vcError : k == 1 ? m.remanence : k == 2 ? m.noise : m.secs;
+				s += v;
+				ss += v * v;
+			}
+			stats[k]->mean = s / repeats;
+			stats[k]->stddev = repeats > 1 ? sqrt(std::max(0.0, (ss - s * s / repeats) / (repeats - 1))) : 0;
+		}
+	}
+}
+
+#endif // __NANOSCRIPT_STUDY_H__
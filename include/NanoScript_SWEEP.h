@@ -0,0 +1,151 @@
+/** \file NanoScript_SWEEP.h
+*	\brief Output sweep paced by a sample clock, with acquisition of inputs
+*
+*	LithoRamp blocks until the ramp is done and returns nothing, so sweeps
+*	that need the response are written as loops of LithoSetSoft and
+*	LithoGetSoft, paced by nothing but the call times. LithoSweepAcquire is
+*	the same stepping put on a fixed sample clock: at every tick it sets the
+*	output and reads the inputs, and the whole sweep ends up in one
+*	LithoSweepBuffer with the time, output value and input values of every
+*	sample.
+*
+*	It is not a ramp: every sample still costs one LithoSet and one LithoGet
+*	per input (802 calls for the 401 points below), the output moves in
+*	steps, and the sample rate is bounded by the call time. What it adds is
+*	an even spacing and a time stamp per sample. A sweep without readback
+*	is cheaper as one LithoRamp (LithoRampLimited, NanoScript_LIMITS.h).
+*
+*	example, 401 point sweep of the tip bias from 2 to -2 V in 2 s,
+*	reading the lock-in output:
+*
+*	LithoSignal in[1] = { lsNS5FPOutput2 };
+*	LithoSweepBuffer buf;
+*	LithoSweepAcquire(lsNS5FPOutput1, 2, -2, 2, in, 1, 200, buf);
+*	for (int i=0; i<buf.Samples(); i++)
+*		file << buf.output[i] << "\t" << 1000 * buf.At(i, 0) << "\n";
+*/
+
+#ifndef __NANOSCRIPT_SWEEP_H__
+#define __NANOSCRIPT_SWEEP_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include "NanoScript_TIMING.h"
+#include "NanoScript_LIMITS.h"
+#include "math.h"
+#include <vector>
+
+
+/// Samples of one sweep
+struct LithoSweepBuffer
+{
+	int					channels;		///< number of inputs read per sample
+	int					late;			///< samples taken more than one period after their tick
+	std::vector<double>	time;			///< seconds from the start of the sweep, middle of the reads
+	std::vector<double>	output;			///< value the output was set to
+	std::vector<double>	data;			///< input values, sample by sample
+
+	LithoSweepBuffer() : channels(0), late(0) {}
+
+	int Samples() const { return (int)time.size(); }
+
+	/// Value of input \p channel at sample \p i
+	double At(int i, int channel) const { return data[i * channels + channel]; }
+};
+
+
+/// Number of samples LithoSweepAcquire takes for a sweep of \p secs at \p rate
+inline int LithoSweepSamples(double secs, double rate)
+{
+	int n = (int)floor(secs * rate + 0.5) + 1;
+	return n < 2 ? 2 : n;
+}
+
+
+/** \brief Step an output on a fixed sample clock and read inputs at every step
+*
+* The output goes from \p startValue to \p endValue in secs * rate steps,
+* one per tick of the sample clock. Ticks are absolute deadlines from the
+* start of the sweep, so a slow read delays one sample but not the ones after it.
+*
+* This version writes into buffers given by the caller (e.g. from a
+* LithoArena, NanoScript_ARENA.h) and allocates nothing.
+*
+* \param inputs Signals read at every tick, in this order.
+* \param nInputs Number of inputs, may be 0 for a plain stepped output.
+* \param rate Sample rate in Hz; with secs it sets the number of samples,
+* see LithoSweepSamples.
+* \param time Receives the time of each sample, seconds from the start.
+* \param outputValues Receives the output value of each sample.
+* \param data Receives the input values, sample by sample.
+* \param capacity Samples the buffers can hold.
+* \param late If not 0, receives the number of samples taken more than one period late.
+* \param soft Values in soft units (LithoSetSoft / LithoGetSoft) or hard
+* units (LithoSet / LithoGet). Hard units avoid the conversion on every
+* call, see NanoScript_CALIB.h.
+*
+* \return Samples taken, fewer than LithoSweepSamples if setting the output
+* failed, 0 if the sweep is outside the session limits (NanoScript_LIMITS.h);
+* -1 if the buffers are too small.
+*/
+inline int LithoSweepAcquire(LithoSignal output, double startValue, double endValue, double secs,
+							const LithoSignal* inputs, int nInputs, double rate,
+							double* time, double* outputValues, double* data, int capacity,
+							int* late = 0, bool soft = true)
+{
+	int n = LithoSweepSamples(secs, rate);
+	if (n > capacity)
+		return -1;
+	if (!LithoLimits().CheckRamp(output, startValue, endValue, secs, soft))
+		return 0;
+	double period = secs / (n - 1);
+	if (late)
+		*late = 0;
+
+	double start = LithoNow();
+	for (int i=0; i<n; i++)
+	{
+		double tick = start + i * period;
+		double v = startValue + (endValue - startValue) * i / (n - 1);
+		if (LithoWaitUntil(tick) > tick + period && late)
+			(*late)++;
+		if (!(soft ? LithoSetSoft(output, v) : LithoSet(output, v)))
+			return i;
+		double before = LithoNow();
+		for (int c=0; c<nInputs; c++)
+			data[i * nInputs + c] = soft ? LithoGetSoft(inputs[c]) : LithoGet(inputs[c]);
+		time[i] = 0.5 * (before + LithoNow()) - start;
+		outputValues[i] = v;
+	}
+	return n;
+}
+
+
+/** \brief Step an output on a fixed sample clock and read inputs at every step
+*
+* As above, into a LithoSweepBuffer.
+*
+* \return \c FALSE if setting the output failed; \p buf holds the samples
+* up to that point.
+*/
+inline bool LithoSweepAcquire(LithoSignal output, double startValue, double endValue, double secs,
+							 const LithoSignal* inputs, int nInputs, double rate, LithoSweepBuffer& buf,
+							 bool soft = true)
+{
+	int n = LithoSweepSamples(secs, rate);
+	buf.channels = nInputs;
+	buf.time.resize(n);
+	buf.output.resize(n);
+	buf.data.resize(n * nInputs + 1);			// + 1: valid pointer without inputs
+	int taken = LithoSweepAcquire(output, startValue, endValue, secs, inputs, nInputs, rate,
+								 &buf.time[0], &buf.output[0], &buf.data[0], n, &buf.late, soft);
+	buf.time.resize(taken);
+	buf.output.resize(taken);
+	buf.data.resize(taken * nInputs);
+	return taken == n;
+}
+
+#endif // __NANOSCRIPT_SWEEP_H__
@@ -0,0 +1,334 @@
+/** \file NanoScript_TASK.h
+*	\brief Coroutine scripts with idle work in the waits
+*
+*	A macro spends most of its time in Sleep() and LithoPause() while the
+*	output file, the analysis and the settings file wait their turn.
+*	Written as C++20 coroutines (LithoTask), a script co_awaits its waits,
+*	pulses and timed reads on a LithoScheduler instead. The scheduler runs
+*	on the macro thread; while every script waits, it calls the idle jobs
+*	(flush the output, fit the data so far, read control commands, ...).
+*
+*	Measurement timing does not change: an idle job is only started if the
+*	time left before the next deadline is longer than its worst case plus a
+*	guard. The worst case is given with the job and raised to the longest
+*	call seen, so even the first call is kept out of a short wait. The last
+*	stretch before each deadline is waited with LithoWaitUntil as before.
+*	How late each script was resumed is kept in Lateness().
+*
+*	Needs C++20 (<coroutine>).
+*
+*	example:
+*
+*	LithoTask Relax(LithoScheduler& s, ofstream& out)
+*	{
+*		co_await s.Pulse(lsBias, 7000, 1);
+*		double t0 = LithoNow();
+*		for (int i=0; i<1000; i++)
+*		{
+*			double amp = co_await s.ReadAt(t0 + 0.01 * i, lsNS5FPOutput2);
+*			buffer << amp << "\n";		// written out by an idle job
+*		}
+*	}
+*
+*	LithoScheduler s;
+*	s.Spawn(Relax(s, out));
+*	s.Idle([&]{ return FlushSome(buffer, out); }, 0.005);		// at most 5 ms per call
+*	s.Run();
+*/
+
+#ifndef __NANOSCRIPT_TASK_H__
+#define __NANOSCRIPT_TASK_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include "NanoScript_TIMING.h"
+#include "NanoScript_LIMITS.h"
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <deque>
+#include <queue>
+#include <vector>
+
+
+/** \brief A script or part of a script, see the file description
+*
+* A task starts suspended. It is run by LithoScheduler::Spawn, or by
+* another task that co_awaits it; an exception in the task comes out of
+* the co_await, or out of LithoScheduler::Run.
+*/
+class LithoTask
+{
+public:
+	struct promise_type;
+	typedef std::coroutine_handle<promise_type> Handle;
+
+	struct promise_type
+	{
+		std::coroutine_handle<>	continuation;		///< task awaiting this one, resumed when it ends
+		std::exception_ptr		error;
+
+		LithoTask get_return_object() { return LithoTask(Handle::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return std::suspend_always(); }
+
+		struct FinalAwaiter
+		{
+			bool await_ready() noexcept { return false; }
+			std::coroutine_handle<> await_suspend(Handle h) noexcept
+			{
+				std::coroutine_handle<> c = h.promise().continuation;
+				return c ? c : std::noop_coroutine();
+			}
+			void await_resume() noexcept {}
+		};
+		FinalAwaiter final_suspend() noexcept { return FinalAwaiter(); }
+
+		void return_void() {}
+		void unhandled_exception() { error = std::current_exception(); }
+	};
+
+	LithoTask() : h() {}
+	explicit LithoTask(Handle handle) : h(handle) {}
+	LithoTask(LithoTask&& t) noexcept : h(t.h) { t.h = Handle(); }
+	LithoTask& operator=(LithoTask&& t) noexcept
+	{
+		if (this != &t)
+		{
+			if (h)
+				h.destroy();
+			h = t.h;
+			t.h = Handle();
+		}
+		return *this;
+	}
+	~LithoTask()
+	{
+		if (h)
+			h.destroy();
+	}
+
+	bool Done() const { return !h || h.done(); }
+
+	/// Rethrow the exception the task ended with, if any
+	void Check() const
+	{
+		if (h && h.promise().error)
+			std::rethrow_exception(h.promise().error);
+	}
+
+	Handle GetHandle() const { return h; }
+
+	// co_await of a task from another task: run it, continue when it ends
+	bool await_ready() const { return Done(); }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting)
+	{
+		h.promise().continuation = awaiting;
+		return h;
+	}
+	void await_resume() const { Check(); }
+
+private:
+	LithoTask(const LithoTask&);
+	LithoTask& operator=(const LithoTask&);
+
+	Handle h;
+};
+
+
+/** \brief Runs tasks on the macro thread and idle jobs while they wait
+*
+* \note Not thread safe; everything happens in Run().
+*/
+class LithoScheduler
+{
+public:
+	/** \param guardSecs Time kept free before each deadline in addition to the idle job's own time.
+	* \param pollSecs Time between two rounds of the idle jobs when none had anything to do.
+	*/
+	explicit LithoScheduler(double guardSecs = 0.002, double pollSecs = 0.005) :
+		guard(guardSecs), poll(pollSecs), sequence(0), nextJob(0), idleCalls(0), idleSecs(0)
+	{}
+
+	/// Start a task when Run() is called (or at once from inside Run)
+	void Spawn(LithoTask task)
+	{
+		ready.push_back(task.GetHandle());
+		tasks.push_back(std::move(task));
+	}
+
+	/** \brief Add an idle job
+	*
+	* \param job Called while all tasks wait; does a small piece of work
+	* and returns \c TRUE, or returns \c FALSE if there was nothing to do.
+	* \param worstSecs Longest a call is expected to take, seconds; used
+	* until a longer call was measured.
+	*/
+	void Idle(std::function<bool()> job, double worstSecs)
+	{
+		IdleJob j = { job, worstSecs };
+		jobs.push_back(j);
+	}
+
+	/** \brief Run until all tasks have ended
+	*
+	* Rethrows the first exception a task ended with, e.g. the one of
+	* LithoAbort, so it reaches LITHO_END.
+	*/
+	void Run()
+	{
+		for (;;)
+		{
+			while (!ready.empty())
+			{
+				std::coroutine_handle<> h = ready.front();
+				ready.pop_front();
+				h.resume();
+			}
+			for (size_t i=0; i<tasks.size(); i++)
+				tasks[i].Check();
+			if (timers.empty())
+				break;
+
+			Timer t = timers.top();
+			timers.pop();
+			for (;;)
+			{
+				double left = t.deadline - LithoNow();
+				if (left <= guard + poll)
+					break;
+				if (!RunIdle(left))
+					LithoWaitUntil(LithoNow() + poll);		// nothing to do right now, ask again later
+			}
+			lateness.Add(LithoWaitUntil(t.deadline) - t.deadline);
+			t.h.resume();
+		}
+	}
+
+	/// \name Awaitables for the tasks
+	///@{
+
+	struct Wait
+	{
+		LithoScheduler* s;
+		double deadline;
+		bool await_ready() const { return false; }
+		void await_suspend(std::coroutine_handle<> h) { s->At(deadline, h); }
+		void await_resume() const {}
+	};
+
+	struct Read
+	{
+		LithoScheduler* s;
+		double deadline;
+		LithoSignal input;
+		bool soft;
+		bool await_ready() const { return false; }
+		void await_suspend(std::coroutine_handle<> h) { s->At(deadline, h); }
+		double await_resume() const { return soft ? LithoGetSoft(input) : LithoGet(input); }
+	};
+
+	/// co_await Until(t): resume at time t (LithoNow() clock)
+	Wait Until(double deadline) { Wait w = { this, deadline }; return w; }
+
+	/// co_await Sleep(secs): resume after secs
+	Wait Sleep(double secs) { return Until(LithoNow() + secs); }
+
+	/// co_await Yield(): let the other tasks and the idle jobs run
+	Wait Yield() { return Until(LithoNow()); }
+
+	/// double v = co_await ReadAt(t, input): read the input at time t
+	Read ReadAt(double deadline, LithoSignal input, bool soft = true)
+	{
+		Read r = { this, deadline, input, soft };
+		return r;
+	}
+
+	/** \brief co_await Pulse(...): software pulse in hard units, like LithoPulse
+	*
+	* Sets the output to \p v, waits (running idle jobs) and sets it back
+	* to \p base. If \p v or \p base is outside the session limits
+	* (NanoScript_LIMITS.h) it is refused and logged, and the pulse is skipped.
+	*/
+	LithoTask Pulse(LithoSignal output, double v, double secs, double base = 0)
+	{
+		double start = LithoNow();
+		if (!LithoLimits().CheckPulse(output, base, false) || !LithoLimits().CheckPulse(output, v, false))
+			co_return;
+		LithoSet(output, v);
+		co_await Until(start + secs);
+		LithoSet(output, base);
+		LithoLimits().Track(output, base, false);		// checked above, never left at v
+	}
+	///@}
+
+	/// How late the tasks were resumed after their deadlines, seconds
+	const LithoTimingStats& Lateness() const { return lateness; }
+
+	/// Idle job calls that did work, and the time they took
+	long IdleCalls() const { return idleCalls; }
+	double IdleSecs() const { return idleSecs; }
+
+private:
+	LithoScheduler(const LithoScheduler&);
+	LithoScheduler& operator=(const LithoScheduler&);
+
+	struct Timer
+	{
+		double deadline;
+		long long seq;					// equal deadlines resume in order
+		std::coroutine_handle<> h;
+		bool operator<(const Timer& t) const { return deadline > t.deadline || (deadline == t.deadline && seq > t.seq); }
+	};
+
+	struct IdleJob
+	{
+		std::function<bool()> run;
+		double longest;					// worst case: the estimate or the longest call so far, seconds
+	};
+
+	void At(double deadline, std::coroutine_handle<> h)
+	{
+		Timer t = { deadline, sequence++, h };
+		timers.push(t);
+	}
+
+	/// One call of the next idle job that fits in the time left. \return \c FALSE if none did any work.
+	bool RunIdle(double left)
+	{
+		for (size_t k=0; k<jobs.size(); k++)
+		{
+			IdleJob& j = jobs[nextJob];
+			nextJob = (nextJob + 1) % jobs.size();
+			if (j.longest + guard >= left)
+				continue;
+			double start = LithoNow();
+			bool worked = j.run();
+			double secs = LithoNow() - start;
+			if (secs > j.longest)
+				j.longest = secs;
+			if (worked)
+			{
+				idleCalls++;
+				idleSecs += secs;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	double guard, poll;
+	long long sequence;
+	std::vector<LithoTask> tasks;
+	std::deque<std::coroutine_handle<> > ready;
+	std::priority_queue<Timer> timers;
+	std::vector<IdleJob> jobs;
+	size_t nextJob;
+	LithoTimingStats lateness;
+	long idleCalls;
+	double idleSecs;
+};
+
+#endif // __NANOSCRIPT_TASK_H__
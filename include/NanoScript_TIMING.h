@@ -0,0 +1,161 @@
+/** \file NanoScript_TIMING.h
+*	\brief High resolution timing helpers for NanoScript macros
+*
+*	Sleep() has a granularity of one scheduler tick (typically 1 - 16 ms),
+*	which is too coarse to measure pulse widths or settle times.
+*	These helpers wrap the Windows performance counter so that macros can
+*	time-stamp events and wait for absolute deadlines.
+*
+*	All times are in seconds, like the Litho functions.
+*/
+
+#ifndef __NANOSCRIPT_TIMING_H__
+#define __NANOSCRIPT_TIMING_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "windows.h"
+#include "math.h"
+
+
+/** \brief Current value of the performance counter in seconds
+*
+* \return Seconds since an arbitrary, fixed origin (system boot).
+* Only differences between two calls are meaningful.
+*/
+inline double LithoNow()
+{
+	static double period = 0;
+	if (period == 0)
+	{
+		LARGE_INTEGER freq;
+		QueryPerformanceFrequency(&freq);
+		period = 1.0 / (double)freq.QuadPart;
+	}
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return (double)now.QuadPart * period;
+}
+
+
+#define LITHO_WAIT_SLICE	0.005		// longest sleep between two calls of the wait hook, seconds
+
+/// Function called by LithoWaitUntil while it waits, may throw to end the wait
+typedef void (*LithoWaitHook)();
+
+/** \brief The hook called by LithoWaitUntil, 0 if none
+*
+* Installed by LithoAbortChannel (NanoScript_ABORT.h), so that an abort
+* request ends any wait built on LithoWaitUntil within LITHO_WAIT_SLICE.
+*/
+inline LithoWaitHook& LithoWaitCheck()
+{
+	static LithoWaitHook hook = 0;
+	return hook;
+}
+
+
+/** \brief Wait until the specified performance counter time
+*
+* Sleeps for the bulk of the wait and spins on the performance
+* counter for the last \p spinSecs, so that the deadline is met to
+* within a few microseconds without burning a core for long waits.
+*
+* If a wait hook is installed (see LithoWaitCheck), it is called before
+* the wait and after every sleep, and sleeps are cut into slices of at
+* most LITHO_WAIT_SLICE.
+*
+* \param deadline Absolute time as returned by LithoNow().
+* \param spinSecs Portion of the wait that is busy-waited.
+*
+* \return The time at which the wait actually ended.
+*/
+inline double LithoWaitUntil(double deadline, double spinSecs = 0.002)
+{
+	LithoWaitHook hook = LithoWaitCheck();
+	if (hook)
+		hook();
+	double now = LithoNow();
+	while (deadline - now > spinSecs)
+	{
+		double secs = deadline - now - spinSecs;
+		if (hook && secs > LITHO_WAIT_SLICE)
+			secs = LITHO_WAIT_SLICE;
+		Sleep((DWORD)(1000 * secs));
+		if (hook)
+			hook();
+		now = LithoNow();
+	}
+	while (now < deadline)
+		now = LithoNow();
+	return now;
+}
+
+
+/** \brief Simple stopwatch based on LithoNow()
+*
+* example:
+*
+* LithoStopwatch sw;
+* LithoPulse(lsBias, 1000, 0.01);
+* double secs = sw.Elapsed();
+*/
+class LithoStopwatch
+{
+public:
+	LithoStopwatch() : start(LithoNow()) {}
+
+	/// Restart the stopwatch and return the time elapsed before the restart
+	double Restart()
+	{
+		double now = LithoNow();
+		double elapsed = now - start;
+		start = now;
+		return elapsed;
+	}
+
+	/// Seconds since construction or the last Restart()
+	double Elapsed() const { return LithoNow() - start; }
+
+	/// Performance counter time at which the stopwatch was (re)started
+	double Start() const { return start; }
+
+private:
+	double start;
+};
+
+
+/** \brief Running min/max/mean/standard deviation of a series of timings
+*
+* Uses Welford's update so it is numerically stable for long runs
+* and needs no storage for the individual samples.
+*/
+class LithoTimingStats
+{
+public:
+	LithoTimingStats() : n(0), mean(0), m2(0), lo(0), hi(0) {}
+
+	void Add(double x)
+	{
+		n++;
+		double d = x - mean;
+		mean += d / n;
+		m2 += d * (x - mean);
+		if (n == 1 || x < lo) lo = x;
+		if (n == 1 || x > hi) hi = x;
+	}
+
+	long	Count() const	{ return n; }
+	double	Mean() const	{ return mean; }
+	double	Min() const		{ return lo; }
+	double	Max() const		{ return hi; }
+	double	StdDev() const	{ return n > 1 ? sqrt(m2 / (n - 1)) : 0; }
+
+private:
+	long n;
+	double mean, m2, lo, hi;
+};
+
+#endif // __NANOSCRIPT_TIMING_H__
@@ -0,0 +1,129 @@
+/** \file NanoScript_TRAIN.h
+*	\brief Pulse trains with absolute edge timing
+*
+*	A train built from LithoSetSoft and Sleep() drifts: every edge is late
+*	by the call time of LithoSetSoft plus up to one scheduler tick, and
+*	since each Sleep() starts where the previous one ended, the errors add
+*	up over the train. LithoPulseTrain plans all edges against the start
+*	of the train and waits for each one with LithoWaitUntil, so the error
+*	of one edge does not shift the following ones. The process is captured
+*	(LithoCriticalSection) only shortly before each edge, so the GUI stays
+*	usable during long pulses and gaps.
+*
+*	The measured time of every edge is returned, so the macro can log
+*	what was actually applied.
+*
+*	example, three 20 s bias pulses of 1 V with 0.5 s gaps:
+*
+*	double amp[3] = { 1000, 1000, 1000 }, width[3] = { 20, 20, 20 }, gap[3] = { 0.5, 0.5, 0.5 };
+*	LithoTrainEdge edges[6];
+*	LithoPulseTrain(lsBias, amp, width, gap, 3, edges);
+*/
+
+#ifndef __NANOSCRIPT_TRAIN_H__
+#define __NANOSCRIPT_TRAIN_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include "NanoScript_TIMING.h"
+#include "NanoScript_RELEASE.h"
+#include "NanoScript_LIMITS.h"
+#include "math.h"
+#include <memory>
+
+
+/// Planned and measured time of one edge, in seconds from the start of the train
+struct LithoTrainEdge
+{
+	double	planned;
+	double	actual;			///< middle of the set call
+	double	uncertainty;	///< half the duration of the set call
+	double	value;			///< value the signal was set to
+};
+
+
+/** \brief Apply a train of rectangular pulses
+*
+* Pulse \c i sets \p signal to \p amplitudes[i] for \p widths[i] seconds,
+* then to \p base for \p gaps[i] seconds. The signal is left at \p base.
+*
+* \param edges Receives the 2 * \p n edges (rise, fall, rise, ...), may be 0.
+* Edges that were not applied, including one whose set call failed, have
+* \c actual set to NaN.
+* \param soft Amplitudes in soft units (LithoSetSoft) or hard units (LithoSet).
+* \param base Value between the pulses.
+* \param captureSecs The process is captured from this long before each
+* edge until the edge, and kept captured if the next edge follows within
+* this time. 0 never captures.
+*
+* \return \c FALSE if a set call failed; the signal is set back to \p base.
+* Also \c FALSE, before the first edge, if \p base or an amplitude is
+* outside the session limits (NanoScript_LIMITS.h).
+*/
+inline bool LithoPulseTrain(LithoSignal signal, const double* amplitudes, const double* widths, const double* gaps,
+							int n, LithoTrainEdge* edges = 0, bool soft = true, double base = 0,
+							double captureSecs = 0.02)
+{
+	if (edges)
+		for (int e=0; e<2*n; e++)
+		{
+			edges[e].planned = edges[e].actual = edges[e].uncertainty = NAN;
+			edges[e].value = e % 2 == 0 ? amplitudes[e / 2] : base;
+		}
+	LithoInterlock& limits = LithoLimits();
+	if (!limits.CheckSet(signal, base, soft))
+		return false;
+	for (int i=0; i<n; i++)
+		if (!limits.CheckPulse(signal, amplitudes[i], soft))
+			return false;
+
+	std::unique_ptr<LithoCriticalSection> cs;
+	double start = LithoNow();
+	double planned = 0;
+	for (int e=0; e<2*n; e++)
+	{
+		int i = e / 2;
+		double value = e % 2 == 0 ? amplitudes[i] : base;
+		double deadline = start + planned;
+
+		// release for the long waits, capture for the edge
+		if (deadline - LithoNow() > captureSecs)
+		{
+			cs.reset();
+			LithoWaitUntil(deadline - captureSecs);
+		}
+		if (captureSecs > 0 && !cs)
+			cs.reset(new LithoCriticalSection);
+		double before = LithoWaitUntil(deadline);
+		bool ok = soft ? LithoSetSoft(signal, value) : LithoSet(signal, value);
+		double after = LithoNow();
+
+		if (edges)
+		{
+			edges[e].planned = planned;
+			edges[e].actual = 0.5 * (before + after) - start;
+			edges[e].uncertainty = 0.5 * (after - before);
+			edges[e].value = value;
+		}
+		if (!ok)
+		{
+			if (edges)
+				edges[e].actual = NAN;
+			if (soft)
+				LithoSetSoft(signal, base);
+			else
+				LithoSet(signal, base);
+			return false;
+		}
+		planned += e % 2 == 0 ? widths[i] : gaps[i];
+	}
+	// the last gap belongs to the train
+	cs.reset();
+	LithoWaitUntil(start + planned);
+	return true;
+}
+
+#endif // __NANOSCRIPT_TRAIN_H__
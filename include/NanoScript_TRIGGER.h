@@ -0,0 +1,113 @@
+/** \file NanoScript_TRIGGER.h
+*	\brief Trigger lines time-stamped on the macro clock
+*
+*	LithoTrigger generates a ~200 ns pulse on D0 or D1. Wiring that line
+*	into an external digitizer marks the instant of each pulse or probe step
+*	in the high-rate capture. LithoSyncLog fires the trigger, records when it
+*	happened on the performance counter clock and keeps a step table, so the
+*	external capture can later be aligned with the macro's results
+*	(see tools/TriggerAlign.cpp).
+*
+*	example:
+*
+*	LithoSyncLog sync;
+*	LithoPulse(lsBias, 1000*v, 0.1);
+*	double t = sync.Mark(tlD0, v);		// step 0, on D0
+*	myfile << v << "\t" << t << "\n";
+*	...
+*	sync.WriteTable("steps.txt");
+*/
+
+#ifndef __NANOSCRIPT_TRIGGER_H__
+#define __NANOSCRIPT_TRIGGER_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "NanoScript_Litho.h"
+#include "NanoScript_TIMING.h"
+#include "fstream"
+#include <vector>
+
+
+/// One entry of the step table
+struct LithoSyncStep
+{
+	int			step;			///< running step number
+	TriggerLine	line;			///< line the trigger was fired on
+	double		value;			///< set value of the step, e.g. pulse or probe voltage
+	double		time;			///< trigger time in seconds since the log was created
+	double		uncertainty;	///< duration of the LithoTrigger call, bounds the timing error
+	bool		fired;			///< \c FALSE if LithoTrigger reported a failure
+};
+
+
+/** \brief Fires trigger pulses and keeps a time-stamped step table
+*
+* The time of a step is the midpoint of the LithoTrigger call, measured
+* relative to the creation of the log. The call duration is recorded as
+* the uncertainty of that time.
+*/
+class LithoSyncLog
+{
+public:
+	/** \param enable Pass \c FALSE to record the step table without
+	* firing the trigger lines.
+	*/
+	explicit LithoSyncLog(bool enable = true) : origin(LithoNow()), enabled(enable) {}
+
+	/** \brief Fire a trigger and record a step
+	*
+	* \param line Trigger line to pulse.
+	* \param value Set value associated with the step, stored in the table.
+	*
+	* \return Time of the trigger in seconds since the log was created.
+	*/
+	double Mark(TriggerLine line, double value)
+	{
+		LithoSyncStep s;
+		s.step = (int)steps.size();
+		s.line = line;
+		s.value = value;
+		double t0 = LithoNow();
+		s.fired = enabled ? LithoTrigger(line) : false;
+		double t1 = LithoNow();
+		s.time = 0.5 * (t0 + t1) - origin;
+		s.uncertainty = t1 - t0;
+		steps.push_back(s);
+		return s.time;
+	}
+
+	/// Recorded steps in the order they were marked
+	const std::vector<LithoSyncStep>& Steps() const { return steps; }
+
+	/** \brief Write the step table as tab separated text
+	*
+	* Columns: step, line (D0/D1), value, time (s), uncertainty (s), fired.
+	*
+	* \return \c TRUE if the file could be written.
+	*/
+	bool WriteTable(const char* fileName) const
+	{
+		std::ofstream f(fileName);
+		if (!f)
+			return false;
+		f << "#step\tline\tvalue\ttime\tuncertainty\tfired\n";
+		f.precision(12);
+		for (size_t i=0; i<steps.size(); i++)
+		{
+			const LithoSyncStep& s = steps[i];
+			f << s.step << "\t" << (s.line == tlD0 ? "D0" : "D1") << "\t" << s.value << "\t"
+			  << s.time << "\t" << s.uncertainty << "\t" << s.fired << "\n";
+		}
+		return f.good();
+	}
+
+private:
+	double origin;
+	bool enabled;
+	std::vector<LithoSyncStep> steps;
+};
+
+#endif // __NANOSCRIPT_TRIGGER_H__
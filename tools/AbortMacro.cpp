@@ -0,0 +1,30 @@
+// AbortMacro.cpp
+// Aborts the running macro through its abort channel (NanoScript_ABORT.h), e.g. Relaxor Char.cpp or Piezoreponse.cpp,
+// and prints the time the macro took from the request to all outputs at zero.
+// This is a stand-alone console program, not a macro.
+//
+// usage: AbortMacro [timeout] [channel]
+//
+//  timeout	seconds to wait for the macro to answer (default 5)
+//  channel	name of the channel (default: NanoScriptAbort)
+//
+// Exit code: 0 if the macro answered, 1 if no macro holds the channel or it did not answer in time.
+
+#include "NanoScript_ABORT.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char* argv[])
+{
+	double timeout = argc > 1 ? atof(argv[1]) : 5;
+	const char* channel = argc > 2 ? argv[2] : LITHO_ABORT_NAME;
+
+	double latency = 0;
+	if (!LithoRequestAbort(&latency, timeout, channel))
+	{
+		fprintf(stderr, "no macro answered on channel %s\n", channel);
+		return 1;
+	}
+	printf("outputs at zero %.3f ms after the request\n", 1000 * latency);
+	return 0;
+}
@@ -0,0 +1,90 @@
+// DatasetSlice.cpp
+// Prints the axes and chunk index of a dataset file (NanoScript_DATASET.h), or one slice of it.
+// This is a stand-alone console program, not a macro.
+//
+// usage: DatasetSlice file [axis position]
+//
+//  file		dataset written by a macro, e.g. "Ferroelectric Char.lds"
+//  axis		axis held fixed, by number (0, 1, ...) or name
+//  position	point along that axis, by index
+//
+// Without axis and position the axes and the min/max of every chunk are printed.
+// With them, the slice is printed as coordinates of the remaining axes and the value.
+
+#include "NanoScript_DATASET.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: DatasetSlice file [axis position]\n");
+		return 2;
+	}
+	LithoDataset ds;
+	if (!ds.Open(argv[1]))
+	{
+		fprintf(stderr, "cannot read %s\n", argv[1]);
+		return 1;
+	}
+	int rank = ds.Rank();
+
+	if (argc < 4)
+	{
+		for (int i=0; i<rank; i++)
+		{
+			const LithoDatasetAxis& a = ds.Axis(i);
+			printf("# axis %d %s: %lld points from %g step %g, chunk %lld\n", i, a.name, a.size, a.start, a.step, a.chunk);
+		}
+		printf("#chunk\tcount\tmin\tmax\n");
+		for (long long c=0; c<ds.Chunks(); c++)
+		{
+			const LithoChunkStats& s = ds.Stats(c);
+			printf("%lld\t%lld\t%g\t%g\n", c, s.count, s.min, s.max);
+		}
+		return 0;
+	}
+
+	int axis = -1;
+	for (int i=0; i<rank; i++)
+		if (strcmp(argv[2], ds.Axis(i).name) == 0)
+			axis = i;
+	if (axis < 0)
+		axis = atoi(argv[2]);
+	long long position = atoll(argv[3]);
+	std::vector<double> values;
+	if (axis < 0 || axis >= rank || !ds.ReadSlice(axis, position, values))
+	{
+		fprintf(stderr, "no slice %s %s in %s\n", argv[2], argv[3], argv[1]);
+		return 1;
+	}
+
+	const LithoDatasetAxis& fixed = ds.Axis(axis);
+	printf("# %s = %g\n#", fixed.name, fixed.start + position * fixed.step);
+	for (int i=0; i<rank; i++)
+		if (i != axis)
+			printf("%s\t", ds.Axis(i).name);
+	printf("value\n");
+	for (size_t v=0; v<values.size(); v++)
+	{
+		// coordinates of the remaining axes, last axis fastest
+		long long rest = (long long)v;
+		double coord[LITHO_DATASET_MAXRANK];
+		for (int i=rank-1; i>=0; i--)
+		{
+			if (i == axis)
+				continue;
+			const LithoDatasetAxis& a = ds.Axis(i);
+			coord[i] = a.start + (rest % a.size) * a.step;
+			rest /= a.size;
+		}
+		for (int i=0; i<rank; i++)
+			if (i != axis)
+				printf("%g\t", coord[i]);
+		printf("%g\n", values[v]);
+	}
+	return 0;
+}
@@ -0,0 +1,46 @@
+// FeedTail.cpp
+// Prints the records of a live data feed (NanoScript_FEED.h) as they are published.
+// This is a stand-alone console program, not a macro. Several can run at the same time.
+//
+// usage: FeedTail [feed] [new]
+//
+//  feed	name of the feed (default: Piezoresponse)
+//  new		only show records published from now on, not the ones still in the ring
+
+#include "NanoScript_FEED.h"
+#include <stdio.h>
+#include <string.h>
+
+int main(int argc, char* argv[])
+{
+	const char* name = argc > 1 ? argv[1] : "Piezoresponse";
+	bool fromStart = !(argc > 2 && strcmp(argv[2], "new") == 0);
+
+	LithoFeedReader feed;
+	fprintf(stderr, "waiting for feed %s\n", name);
+	while (!feed.Open(name, fromStart))
+		Sleep(500);
+
+	printf("#seq\ttime\t%s\n", feed.Names());
+	LONG64 lost = 0;
+	LithoFeedRecord r;
+	for (;;)
+	{
+		if (!feed.Next(r))
+		{
+			fflush(stdout);
+			Sleep(20);
+			continue;
+		}
+		if (feed.Lost() != lost)
+		{
+			printf("# %lld records lost\n", (long long)(feed.Lost() - lost));
+			lost = feed.Lost();
+		}
+		printf("%lld\t%.6f", (long long)r.stamp, r.time);
+		for (int i=0; i<feed.Channels(); i++)
+			printf("\t%g", r.values[i]);
+		printf("\n");
+	}
+	return 0;
+}
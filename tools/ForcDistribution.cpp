@@ -0,0 +1,82 @@
+// ForcDistribution.cpp
+// Computes the FORC distribution of a measurement written by the FORC mode of Testor.cpp (NanoScript_FORC.h).
+// This is a stand-alone console program, not a macro.
+//
+// usage: ForcDistribution file [sf [threads [out]]]
+//
+//  file		FORC dataset, e.g. "Testor FORC.lds"
+//  sf			smoothing factor, the fit spans (2 sf + 1)^2 grid points (default 3)
+//  threads		worker threads (default: one per core)
+//  out			write the distribution as a dataset of the same shape instead of text
+//
+// Output (stdout): Vr, V and rho for every point with enough data, and the time taken.
+
+#include "NanoScript_FORC.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: ForcDistribution file [sf [threads [out]]]\n");
+		return 2;
+	}
+	LithoDataset ds;
+	if (!ds.Open(argv[1]) || ds.Rank() != 2 || ds.Axis(0).size != ds.Axis(1).size)
+	{
+		fprintf(stderr, "%s is not a FORC dataset\n", argv[1]);
+		return 1;
+	}
+	int sf = argc > 2 ? atoi(argv[2]) : 3;
+	int threads = argc > 3 ? atoi(argv[3]) : 0;
+
+	const LithoDatasetAxis& a = ds.Axis(1);
+	int n = (int)a.size;
+	long long lo[2] = { 0, 0 }, hi[2] = { n, n };
+	std::vector<double> m, rho;
+	if (!ds.ReadBox(lo, hi, m))
+	{
+		fprintf(stderr, "cannot read %s\n", argv[1]);
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	ForcDistribution(m, n, a.step, sf, rho, threads);
+	double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+	if (argc > 4)
+	{
+		LithoDatasetAxis axes[2] = { ds.Axis(0), ds.Axis(1) };
+		LithoDataset out;
+		if (!out.Create(argv[4], 2, axes))
+		{
+			fprintf(stderr, "cannot write %s\n", argv[4]);
+			return 1;
+		}
+		for (int r=0; r<n; r++)
+			for (int j=r; j<n; j++)
+			{
+				double v = rho[(size_t)r * n + j];
+				long long at[2] = { r, j };
+				if (v == v)
+					out.Set(at, v);
+			}
+		out.Close();
+	}
+	else
+	{
+		printf("#Vr\tV\trho\n");
+		for (int r=0; r<n; r++)
+			for (int j=r; j<n; j++)
+			{
+				double v = rho[(size_t)r * n + j];
+				if (v == v)
+					printf("%g\t%g\t%g\n", a.start + r * a.step, a.start + j * a.step, v);
+			}
+	}
+	fprintf(stderr, "%d x %d grid, sf %d, %.3f s\n", n, n, sf, secs);
+	return 0;
+}
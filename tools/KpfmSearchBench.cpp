@@ -0,0 +1,118 @@
+// KpfmSearchBench.cpp
+// Compares ways of finding the contact potential on simulated instruments (srKpfm readout):
+// the 401 point sweep of Ferroelectric Char.cpp, the root search KpfmFindZero and the
+// nulling loop KpfmNull (NanoScript_KPFM.h). This is a stand-alone console program, not a macro.
+//
+// usage: KpfmSearchBench [trials] [reads] [noise]
+//
+//  trials	samples with random contact potentials in -1.5..1.5 V (default 100)
+//  reads	reads averaged per point of the search (default 4)
+//  noise	rms noise of the response (default: SimModel default)
+//
+// Output (stdout): per method the points, reads and instrument time per result, the
+// mean and rms error of the potential over the results found, and the trials without one.
+
+#include "NanoScript_SIM.h"
+#include "NanoScript_KPFM.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct BenchStat
+{
+	double points, reads, secs, err, err2;
+	int found, failed;
+	BenchStat() : points(0), reads(0), secs(0), err(0), err2(0), found(0), failed(0) {}
+
+	void Add(double p, double r, double s, double e)
+	{
+		points += p; reads += r; secs += s; err += e; err2 += e * e;
+		found++;
+	}
+
+	// the cost of a trial without a result still counts, its potential does not
+	void Fail(double p, double r, double s)
+	{
+		points += p; reads += r; secs += s;
+		failed++;
+	}
+
+	void Print(const char* name) const
+	{
+		int n = found + failed;
+		printf("%-8s\t%8.1f\t%8.1f\t%8.4f\t%+9.5f\t%9.5f\t%d\n", name, points / n, reads / n, secs / n,
+			   found ? err / found : NAN, found ? sqrt(err2 / found) : NAN, failed);
+	}
+};
+
+// the read sweep of Ferroelectric Char.cpp: 401 points from 2 to -2 V, one read each,
+// zero crossing from a least squares line through all points
+static double SweepPotential(SimInstrument& sim, int& points)
+{
+	const double V_step = 100;
+	double sv = 0, se = 0, svv = 0, sve = 0;
+	int n = 0;
+	for (int ii=2*V_step; ii>=-2*V_step; ii--)
+	{
+		double v = ii / V_step;
+		sim.SetSoft(lsNS5FPOutput1, v);
+		double e = sim.GetSoft(lsNS5FPOutput2);
+		if (e == 0)
+			continue;
+		sv += v; se += e; svv += v * v; sve += v * e;
+		n++;
+	}
+	points = int(4 * V_step) + 1;
+	double gain = (n * sve - sv * se) / (n * svv - sv * sv);
+	double offset = (se - gain * sv) / n;
+	return -offset / gain;
+}
+
+int main(int argc, char* argv[])
+{
+	int trials = argc > 1 ? atoi(argv[1]) : 100;
+	int reads = argc > 2 ? atoi(argv[2]) : 4;
+	SimModel model;
+	model.readout = srKpfm;
+	model.potentialPerPolarization = 0;			// keep the potential fixed during a trial
+	if (argc > 3)
+		model.noise = atof(argv[3]);
+
+	BenchStat sweep, search, null;
+	std::mt19937 rng(12345);
+	std::uniform_real_distribution<double> potential(-1.5, 1.5);
+	for (int t=0; t<trials; t++)
+	{
+		model.surfacePotential = potential(rng);
+		model.seed = t + 1;
+
+		SimInstrument a(model);
+		int points;
+		double start = a.Now();
+		double v = SweepPotential(a, points);
+		sweep.Add(points, points, a.Now() - start, v - a.ContactPotential());
+
+		SimInstrument b(model);
+		KpfmSearchParams sp;
+		sp.reads = reads;
+		KpfmSearchResult sr = KpfmFindZero(b, sp);
+		if (sr.found)
+			search.Add(sr.points, sr.reads, sr.secs, sr.potential - b.ContactPotential());
+		else
+			search.Fail(sr.points, sr.reads, sr.secs);
+
+		SimInstrument c(model);
+		KpfmNullParams np;
+		KpfmNullResult nr = KpfmNull(c, np);
+		if (nr.nulled)
+			null.Add(nr.iterations, nr.iterations, nr.secs, nr.potential - c.ContactPotential());
+		else
+			null.Fail(nr.iterations, nr.iterations, nr.secs);
+	}
+
+	printf("#method \tpoints  \treads   \tsecs    \tmean_err_V\trms_err_V\tfailed\n");
+	sweep.Print("sweep");
+	search.Print("search");
+	null.Print("null");
+	return 0;
+}
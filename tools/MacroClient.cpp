@@ -0,0 +1,96 @@
+// MacroClient.cpp
+// Sends a request to the resident macro server ("Macro Server.cpp") and prints the reply
+// with the round trip time. This is a stand-alone console program, not a macro.
+//
+// usage: MacroClient request [repeat [timeout]]
+//
+//  request	a queue line (NanoScript_BATCH.h), or ping, stats, quit; quote it if it has spaces
+//  repeat	send the request this many times and print round trip statistics (default: 1)
+//  timeout	seconds to wait for a reply, experiment included (default: 3600)
+//
+// example: MacroClient "pfm_loop V_max=6" 3
+//			MacroClient ping 1000
+
+#include "NanoScript_SERVER.h"
+#include "NanoScript_TIMING.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+// one request: connect, send, read the reply line within timeout seconds
+static bool Request(const std::string& request, std::string& reply, double timeout)
+{
+	HANDLE pipe;
+	for (;;)
+	{
+		pipe = CreateFileA(LITHO_SERVER_PIPE, GENERIC_READ | GENERIC_WRITE, 0, 0, OPEN_EXISTING, 0, 0);
+		if (pipe != INVALID_HANDLE_VALUE)
+			break;
+		if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeA(LITHO_SERVER_PIPE, 10000))
+			return false;
+	}
+	std::string text = request + "\n";
+	DWORD n = 0;
+	bool ok = WriteFile(pipe, text.c_str(), (DWORD)text.size(), &n, 0) != 0;
+	reply.clear();
+	// ReadFile on the pipe cannot time out: read only what has arrived
+	double deadline = LithoNow() + timeout;
+	char c = 0;
+	while (ok && c != '\n')
+	{
+		DWORD avail = 0;
+		if (!PeekNamedPipe(pipe, 0, 0, 0, &avail, 0))
+			ok = false;						// the server closed the pipe
+		else if (avail == 0)
+		{
+			if (LithoNow() > deadline)
+				ok = false;
+			else
+				Sleep(1);
+		}
+		else if (!ReadFile(pipe, &c, 1, &n, 0) || n != 1)
+			ok = false;
+		else if (c != '\n' && c != '\r')
+			reply += c;
+	}
+	CloseHandle(pipe);
+	return ok && !reply.empty();
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: MacroClient request [repeat [timeout]]\n");
+		return 2;
+	}
+	std::string request = argv[1];
+	int repeat = argc > 2 ? atoi(argv[2]) : 1;
+	double timeout = argc > 3 ? atof(argv[3]) : 3600;
+
+	// round trip = client overhead + pipe + dispatch + experiment; the
+	// server reports the last two, the rest is the cost of a request
+	LithoTimingStats trip, overhead;
+	for (int i=0; i<repeat; i++)
+	{
+		std::string reply;
+		LithoStopwatch sw;
+		if (!Request(request, reply, timeout))
+		{
+			fprintf(stderr, "no reply from %s, is \"Macro Server\" running?\n", LITHO_SERVER_PIPE);
+			return 1;
+		}
+		double secs = sw.Elapsed();
+		double run = 0, dispatch = 0;
+		sscanf(reply.c_str(), "%*s %lf %lf", &run, &dispatch);
+		trip.Add(secs);
+		overhead.Add(secs - run);
+		if (repeat == 1 || i == repeat - 1)
+			printf("%s\n", reply.c_str());
+	}
+	printf("# round trip %.6f s", trip.Mean());
+	if (repeat > 1)
+		printf(" (min %.6f, max %.6f, sd %.6f, %ld requests)", trip.Min(), trip.Max(), trip.StdDev(), trip.Count());
+	printf("\n# startup latency %.6f s per request (round trip - experiment)\n", overhead.Mean());
+	return 0;
+}
@@ -0,0 +1,105 @@
+// ParameterStudy.cpp
+// Monte-Carlo study of the Piezoreponse.cpp loop parameters on simulated instruments
+// (NanoScript_STUDY.h). This is a stand-alone console program, not a macro.
+//
+// usage: ParameterStudy [name=v1,v2,...] ...
+//
+//  V_step=...			voltage steps to try (V)
+//  pulse_dura=...		pulse widths to try (s)
+//  post_pulse_time=...	waits between pulse and reads (s)
+//  V_max=...			maximum voltages to try (V)
+//  repeats=n			noise realizations per grid point (default 20)
+//  threads=n			worker threads (default: one per core)
+//  noise=v  drift=v  glitch=v  tau=v	model parameters
+//
+// Output (stdout): one line per grid point with mean and standard deviation of
+// the coercive voltage error, remanence, noise and loop duration.
+
+#include "NanoScript_STUDY.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+static vector<double> ParseList(const char* text)
+{
+	vector<double> v;
+	while (*text)
+	{
+		char* end;
+		double x = strtod(text, &end);
+		if (end == text)
+			break;
+		v.push_back(x);
+		text = *end == ',' ? end + 1 : end;
+	}
+	return v;
+}
+
+int main(int argc, char* argv[])
+{
+	vector<double> V_max(1, 8);
+	vector<double> V_step, pulse_dura, post_pulse_time;
+	V_step.push_back(0.05); V_step.push_back(0.1); V_step.push_back(0.2);
+	pulse_dura.push_back(0.01); pulse_dura.push_back(0.1);
+	post_pulse_time.push_back(0.01); post_pulse_time.push_back(0.03); post_pulse_time.push_back(0.1); post_pulse_time.push_back(0.3);
+	int repeats = 20, threads = 0;
+	SimModel model;
+
+	for (int a=1; a<argc; a++)
+	{
+		const char* eq = strchr(argv[a], '=');
+		if (!eq)
+		{
+			fprintf(stderr, "ignoring argument %s\n", argv[a]);
+			continue;
+		}
+		string name(argv[a], eq - argv[a]);
+		const char* value = eq + 1;
+		if (name == "V_step")				V_step = ParseList(value);
+		else if (name == "pulse_dura")		pulse_dura = ParseList(value);
+		else if (name == "post_pulse_time")	post_pulse_time = ParseList(value);
+		else if (name == "V_max")			V_max = ParseList(value);
+		else if (name == "repeats")			repeats = atoi(value);
+		else if (name == "threads")			threads = atoi(value);
+		else if (name == "noise")			model.noise = atof(value);
+		else if (name == "drift")			model.drift = atof(value);
+		else if (name == "glitch")			model.glitchRate = atof(value);
+		else if (name == "tau")				model.lockinTau = atof(value);
+		else
+			fprintf(stderr, "unknown parameter %s\n", name.c_str());
+	}
+
+	vector<PfmLoopParams> grid;
+	for (size_t a=0; a<V_max.size(); a++)
+		for (size_t b=0; b<V_step.size(); b++)
+			for (size_t c=0; c<pulse_dura.size(); c++)
+				for (size_t d=0; d<post_pulse_time.size(); d++)
+				{
+					PfmLoopParams p;
+					p.V_max = V_max[a];
+					p.V_step = V_step[b];
+					p.pulse_dura = pulse_dura[c];
+					p.post_pulse_time = post_pulse_time[d];
+					grid.push_back(p);
+				}
+
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	vector<StudyResult> results;
+	RunParameterStudy(grid, model, repeats, threads, results);
+	double wall = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+	printf("#V_max\tV_step\tpulse_dura\tpost_pulse_time\tvc_error\tvc_error_sd\tremanence_mV\tremanence_sd\tnoise_mV\tnoise_sd\tloop_s\n");
+	for (size_t i=0; i<results.size(); i++)
+	{
+		const StudyResult& r = results[i];
+		printf("%g\t%g\t%g\t%g\t%.4f\t%.4f\t%.3f\t%.3f\t%.4f\t%.4f\t%.1f\n", r.params.V_max, r.params.V_step,
+			   r.params.pulse_dura, r.params.post_pulse_time, r.vcError.mean, r.vcError.stddev,
+			   r.remanence.mean, r.remanence.stddev, r.noise.mean, r.noise.stddev, r.secs.mean);
+	}
+	fprintf(stderr, "%d experiments in %.2f s wall time\n", (int)grid.size() * repeats, wall);
+	return 0;
+}
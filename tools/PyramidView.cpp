@@ -0,0 +1,65 @@
+// PyramidView.cpp
+// Summarizes a time window of a long recording from its pyramid files (NanoScript_PYRAMID.h),
+// e.g. Relaxor.pyr1 ... written by Relaxor Char.cpp. This is a stand-alone console program, not a macro.
+//
+// usage: PyramidView base [t0 t1 [bins]]
+//
+//  base	name of the series, e.g. Relaxor
+//  t0 t1	time window in seconds (default: the whole recording)
+//  bins	number of output lines, e.g. the width of a plot in pixels (default 1000)
+//
+// Output (stdout): one line per bin with its time span, min, max, mean and sample count.
+// The time taken depends on the number of bins, not on the length of the recording.
+
+#include "NanoScript_PYRAMID.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: PyramidView base [t0 t1 [bins]]\n");
+		return 2;
+	}
+	LithoPyramidReader pyr;
+	if (!pyr.Open(argv[1]))
+	{
+		fprintf(stderr, "no pyramid files %s.pyr1 ...\n", argv[1]);
+		return 1;
+	}
+
+	double t0 = 0, t1 = 0;
+	if (argc > 3)
+	{
+		t0 = atof(argv[2]);
+		t1 = atof(argv[3]);
+	}
+	else
+	{
+		// whole recording: first and last bin of level 1
+		LithoPyramidBin first, last;
+		long long n = pyr.Bins(1);
+		if (n == 0 || !pyr.Bin(1, 0, first) || !pyr.Bin(1, n - 1, last))
+		{
+			fprintf(stderr, "%s is empty\n", argv[1]);
+			return 1;
+		}
+		t0 = first.t0;
+		t1 = last.t1;
+	}
+	int width = argc > 4 ? atoi(argv[4]) : 1000;
+
+	std::vector<LithoPyramidBin> bins;
+	int level = pyr.Summarize(t0, t1, width, bins);
+	printf("# %s from %g to %g s, level %d of %d\n", argv[1], t0, t1, level, pyr.Levels());
+	printf("#t0\tt1\tmin\tmax\tmean\tcount\n");
+	for (size_t i=0; i<bins.size(); i++)
+	{
+		const LithoPyramidBin& b = bins[i];
+		if (b.count > 0)
+			printf("%g\t%g\t%g\t%g\t%g\t%lld\n", b.t0, b.t1, b.min, b.max, b.Mean(), b.count);
+	}
+	return 0;
+}
@@ -0,0 +1,185 @@
+// TriggerAlign.cpp
+// Aligns an externally captured waveform with the step table written by LithoSyncLog
+// (NanoScript_TRIGGER.h). This is a stand-alone console program, not a macro.
+//
+// usage: TriggerAlign steps.txt waveform.txt rate_hz threshold [column] [D0|D1]
+//
+//  steps.txt		step table from LithoSyncLog::WriteTable
+//  waveform.txt	digitizer capture, one sample per line (whitespace separated columns)
+//  rate_hz			digitizer sample rate
+//  threshold		level of a rising trigger edge on the trigger channel
+//  column			column of waveform.txt holding the trigger channel (default 0)
+//  D0|D1			only align steps fired on this line (default: all steps)
+//
+// Output (stdout): step, line, value, macro time, digitizer time, sample index, residual
+// Digitizer time = offset + scale * macro time, fitted by least squares over the matched edges.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+struct Step
+{
+	int step;
+	string line;
+	double value;
+	double time;
+};
+
+static bool ReadSteps(const char* fileName, const char* lineFilter, vector<Step>& steps)
+{
+	ifstream f(fileName);
+	if (!f)
+		return false;
+	string text;
+	while (getline(f, text))
+	{
+		if (text.empty() || text[0] == '#')
+			continue;
+		istringstream in(text);
+		Step s;
+		if (!(in >> s.step >> s.line >> s.value >> s.time))
+			continue;
+		if (lineFilter && s.line != lineFilter)
+			continue;
+		steps.push_back(s);
+	}
+	return true;
+}
+
+// Rising edges with hysteresis, interpolated to sub-sample resolution. Returned in samples.
+static bool ReadEdges(const char* fileName, int column, double threshold, vector<double>& edges)
+{
+	ifstream f(fileName);
+	if (!f)
+		return false;
+	string text;
+	double prev = 0;
+	bool high = false, first = true;
+	long n = 0;
+	while (getline(f, text))
+	{
+		if (text.empty() || text[0] == '#')
+			continue;
+		istringstream in(text);
+		double v = 0;
+		for (int c=0; c<=column; c++)
+			in >> v;
+		if (!in)
+			continue;
+		if (!first && !high && v >= threshold && prev < threshold)
+		{
+			edges.push_back(n - 1 + (threshold - prev) / (v - prev));
+			high = true;
+		}
+		else if (high && v < 0.5 * threshold)
+			high = false;
+		prev = v;
+		first = false;
+		n++;
+	}
+	return true;
+}
+
+// For every step the nearest edge to its predicted time, -1 if none within tol.
+static void Match(const vector<Step>& steps, const vector<double>& edgeTimes, double offset, double scale,
+				  double tol, vector<int>& match)
+{
+	match.assign(steps.size(), -1);
+	size_t j = 0;
+	for (size_t i=0; i<steps.size(); i++)
+	{
+		double predicted = offset + scale * steps[i].time;
+		while (j + 1 < edgeTimes.size() && fabs(edgeTimes[j + 1] - predicted) <= fabs(edgeTimes[j] - predicted))
+			j++;
+		if (j < edgeTimes.size() && fabs(edgeTimes[j] - predicted) <= tol)
+			match[i] = (int)j;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 5)
+	{
+		fprintf(stderr, "usage: %s steps.txt waveform.txt rate_hz threshold [column] [D0|D1]\n", argv[0]);
+		return 2;
+	}
+	double rate = atof(argv[3]);
+	double threshold = atof(argv[4]);
+	int column = argc > 5 ? atoi(argv[5]) : 0;
+	const char* lineFilter = argc > 6 ? argv[6] : 0;
+
+	vector<Step> steps;
+	vector<double> edges;
+	if (!ReadSteps(argv[1], lineFilter, steps) || steps.empty())
+	{
+		fprintf(stderr, "no steps read from %s\n", argv[1]);
+		return 1;
+	}
+	if (!ReadEdges(argv[2], column, threshold, edges) || edges.empty())
+	{
+		fprintf(stderr, "no trigger edges found in %s\n", argv[2]);
+		return 1;
+	}
+
+	vector<double> edgeTimes(edges.size());
+	for (size_t j=0; j<edges.size(); j++)
+		edgeTimes[j] = edges[j] / rate;
+
+	// matching tolerance: half of the shortest step spacing
+	double tol = 1e30;
+	for (size_t i=1; i<steps.size(); i++)
+		tol = min(tol, 0.5 * (steps[i].time - steps[i - 1].time));
+	if (tol <= 0 || tol > 1e29)
+		tol = 0.5;
+
+	// first guess: the first edge belongs to the first step, clocks run at the same rate
+	double offset = edgeTimes[0] - steps[0].time, scale = 1;
+	vector<int> match;
+	for (int iter=0; iter<3; iter++)
+	{
+		Match(steps, edgeTimes, offset, scale, tol, match);
+		double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+		for (size_t i=0; i<steps.size(); i++)
+		{
+			if (match[i] < 0)
+				continue;
+			double x = steps[i].time, y = edgeTimes[match[i]];
+			n++; sx += x; sy += y; sxx += x * x; sxy += x * y;
+		}
+		if (n >= 2 && n * sxx - sx * sx > 0)
+		{
+			scale = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+			offset = (sy - scale * sx) / n;
+		}
+		else if (n == 1)
+			offset = sy - scale * sx;
+	}
+
+	int matched = 0;
+	double rms = 0;
+	printf("#step\tline\tvalue\tmacro_time\tdigitizer_time\tsample\tresidual\n");
+	for (size_t i=0; i<steps.size(); i++)
+	{
+		double t = offset + scale * steps[i].time;
+		double residual = 0;
+		if (match[i] >= 0)
+		{
+			t = edgeTimes[match[i]];
+			residual = t - (offset + scale * steps[i].time);
+			rms += residual * residual;
+			matched++;
+		}
+		printf("%d\t%s\t%g\t%.9f\t%.9f\t%.1f\t%s%.3g\n", steps[i].step, steps[i].line.c_str(), steps[i].value,
+			   steps[i].time, t, t * rate, match[i] >= 0 ? "" : "unmatched ", residual);
+	}
+	fprintf(stderr, "%d of %d steps matched to %d edges, offset %.9f s, scale %.9f, rms residual %.3g s\n",
+			matched, (int)steps.size(), (int)edges.size(), offset, scale, matched ? sqrt(rms / matched) : 0.0);
+	return 0;
+}